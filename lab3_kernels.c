@@ -0,0 +1,241 @@
+/* File:     lab3_kernels.c
+ *
+ * Purpose:  The vector kernels shared by the Lab 3 programs:  the
+ *           sums, the scalings, the dot product and the STREAM copy,
+ *           scale and triad.
+ *
+ * Compile:  gcc -O3 -Wall -c lab3_kernels.c
+ *
+ * Notes:
+ * 1.  See lab3_kernels.h
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdint.h>
+#include "lab3_kernels.h"
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_sum
+ * Purpose:   Add two vectors
+ * In args:   x:  the first vector to be added
+ *            y:  the second vector to be added
+ *            n:  the order of the vectors
+ * Out arg:   z:  the sum vector
+ *
+ * Note:      z can be x or y, to add in place.  The restrict kernels
+ *            are used when z doesn't overlap the others or is exactly
+ *            one of them; otherwise the plain loop is used, which is
+ *            right as long as z doesn't start after the start of x or
+ *            y.
+ */
+void Vector_sum(
+      double  x[]  /* in  */,
+      double  y[]  /* in  */,
+      double  z[]  /* out */,
+      int     n    /* in  */) {
+   int i;
+
+   if (!Overlap(z, x, n) && !Overlap(z, y, n))
+      Vector_sum_restrict(x, y, z, n);
+   else if (z == x && !Overlap(x, y, n))
+      Vector_add_in_place(x, y, n);
+   else if (z == y && !Overlap(y, x, n))
+      Vector_add_in_place(y, x, n);
+   else
+      for (i = 0; i < n; i++)
+         z[i] = x[i] + y[i];
+}  /* Vector_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_vector_sum
+ * Purpose:   Add a vector that's been distributed among the processes
+ * In args:   local_x:  local storage of one of the vectors being added
+ *            local_y:  local storage for the second vector being added
+ *            local_n:  the number of components in local_x, local_y,
+ *                      and local_z
+ * Out arg:   local_z:  local storage for the sum of the two vectors
+ *
+ * Note:      The sum needs no communication, so this is Vector_sum
+ *            of the local blocks.  local_z can be local_x or local_y.
+ */
+void Parallel_vector_sum(
+      double  local_x[]  /* in  */,
+      double  local_y[]  /* in  */,
+      double  local_z[]  /* out */,
+      int     local_n    /* in  */) {
+
+   Vector_sum(local_x, local_y, local_z, local_n);
+}  /* Parallel_vector_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Overlap
+ * Purpose:   Check whether two blocks of local_n doubles overlap
+ * In args:   a, b, local_n
+ * Ret val:   1 if they overlap, 0 otherwise
+ */
+int Overlap(double a[], double b[], int local_n) {
+   uintptr_t a_start = (uintptr_t) a, b_start = (uintptr_t) b;
+   uintptr_t len = local_n*sizeof(double);
+
+   return a_start < b_start + len && b_start < a_start + len;
+}  /* Overlap */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_sum_restrict
+ * Purpose:   local_z = local_x + local_y, local_z not overlapping the
+ *            others
+ * In args:   local_x, local_y, local_n
+ * Out arg:   local_z
+ */
+void Vector_sum_restrict(
+      const double* restrict  local_x  /* in  */,
+      const double* restrict  local_y  /* in  */,
+      double* restrict        local_z  /* out */,
+      int                     local_n  /* in  */) {
+   int local_i;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_z[local_i] = local_x[local_i] + local_y[local_i];
+}  /* Vector_sum_restrict */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_add_in_place
+ * Purpose:   local_x += local_y, the two not overlapping
+ * In args:   local_y, local_n
+ * In/out:    local_x
+ */
+void Vector_add_in_place(
+      double* restrict        local_x  /* in/out */,
+      const double* restrict  local_y  /* in     */,
+      int                     local_n  /* in     */) {
+   int local_i;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_x[local_i] += local_y[local_i];
+}  /* Vector_add_in_place */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_scale_in_place
+ * Purpose:   local_x *= scalar
+ * In args:   scalar, local_n
+ * In/out:    local_x
+ */
+void Vector_scale_in_place(
+      double  local_x[]  /* in/out */,
+      double  scalar     /* in     */,
+      int     local_n    /* in     */) {
+   int local_i;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_x[local_i] *= scalar;
+}  /* Vector_scale_in_place */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_scalar_multiplication
+ * Purpose:   Multiply two distributed vectors by a scalar, in place
+ * In args:   scalar:   the factor
+ *            local_n:  order of the local blocks
+ * In/out:    local_x, local_y:  local blocks of the vectors
+ */
+void Parallel_scalar_multiplication(
+      double  local_x[]  /* in/out */,
+      double  local_y[]  /* in/out */,
+      double  scalar     /* in     */,
+      int     local_n    /* in     */) {
+   int local_i;
+
+   for (local_i = 0; local_i < local_n; local_i++) {
+      local_x[local_i] *= scalar;
+      local_y[local_i] *= scalar;
+   }
+}  /* Parallel_scalar_multiplication */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Dot_product
+ * Purpose:   Compute the dot product of two vectors:  the local part
+ *            of Parallel_dot_product
+ * In args:   x, y:  the vectors
+ *            n:     the order of the vectors
+ * Ret val:   x.y
+ *
+ * Note:      Four partial sums break the dependence on a single
+ *            accumulator so the loop vectorizes and pipelines.
+ */
+double Dot_product(
+      const double  x[]  /* in */,
+      const double  y[]  /* in */,
+      int           n    /* in */) {
+   int i;
+   double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+
+   for (i = 0; i + 3 < n; i += 4) {
+      s0 += x[i]*y[i];
+      s1 += x[i+1]*y[i+1];
+      s2 += x[i+2]*y[i+2];
+      s3 += x[i+3]*y[i+3];
+   }
+   for (; i < n; i++)
+      s0 += x[i]*y[i];
+   return (s0 + s1) + (s2 + s3);
+}  /* Dot_product */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_copy
+ * Purpose:   c = a, STREAM's Copy
+ * In args:   a, n
+ * Out arg:   c
+ */
+void Vector_copy(
+      double  a[]  /* in  */,
+      double  c[]  /* out */,
+      int     n    /* in  */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      c[i] = a[i];
+}  /* Vector_copy */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_scale
+ * Purpose:   b = scalar*c, STREAM's Scale
+ * In args:   c, scalar, n
+ * Out arg:   b
+ */
+void Vector_scale(
+      double  c[]     /* in  */,
+      double  b[]     /* out */,
+      double  scalar  /* in  */,
+      int     n       /* in  */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      b[i] = scalar*c[i];
+}  /* Vector_scale */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Vector_triad
+ * Purpose:   a = b + scalar*c, STREAM's Triad
+ * In args:   b, c, scalar, n
+ * Out arg:   a
+ */
+void Vector_triad(
+      double  b[]     /* in  */,
+      double  c[]     /* in  */,
+      double  a[]     /* out */,
+      double  scalar  /* in  */,
+      int     n       /* in  */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      a[i] = b[i] + scalar*c[i];
+}  /* Vector_triad */
@@ -0,0 +1,47 @@
+/* File:     lab3_kernels.h
+ *
+ * Purpose:  Declarations of the vector kernels shared by the Lab 3
+ *           programs, so the benchmarks, the tuned builds and the
+ *           correctness oracle all run the same code.
+ *
+ * Compile:  Link with lab3_kernels.c, and with lab3_kernels_mpi.c for
+ *           the kernels that communicate (declared when <mpi.h> is
+ *           included before this file)
+ *
+ * Notes:
+ * 1.  The local kernels of a block distributed vector take the
+ *     local block and its order, local_n, as in IPP.  The serial
+ *     kernels take the whole vector and n.
+ * 2.  Vector_sum and Parallel_vector_sum allow z to be x or y, so
+ *     they add in place.  They check how the arguments alias and call
+ *     Vector_sum_restrict or Vector_add_in_place when they can.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#ifndef LAB3_KERNELS_H
+#define LAB3_KERNELS_H
+
+void Vector_sum(double x[], double y[], double z[], int n);
+void Parallel_vector_sum(double local_x[], double local_y[],
+      double local_z[], int local_n);
+int Overlap(double a[], double b[], int local_n);
+void Vector_sum_restrict(const double* restrict local_x,
+      const double* restrict local_y, double* restrict local_z,
+      int local_n);
+void Vector_add_in_place(double* restrict local_x,
+      const double* restrict local_y, int local_n);
+void Vector_scale_in_place(double local_x[], double scalar, int local_n);
+void Parallel_scalar_multiplication(double local_x[], double local_y[],
+      double scalar, int local_n);
+double Dot_product(const double x[], const double y[], int n);
+void Vector_copy(double a[], double c[], int n);
+void Vector_scale(double c[], double b[], double scalar, int n);
+void Vector_triad(double b[], double c[], double a[], double scalar,
+      int n);
+
+#ifdef MPI_VERSION
+double Parallel_dot_product(double local_x[], double local_y[],
+      int local_n, MPI_Comm comm);
+#endif
+
+#endif
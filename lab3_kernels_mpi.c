@@ -0,0 +1,33 @@
+/* File:     lab3_kernels_mpi.c
+ *
+ * Purpose:  The shared vector kernels that communicate
+ *
+ * Compile:  mpicc -O3 -Wall -c lab3_kernels_mpi.c
+ *
+ * Notes:
+ * 1.  See lab3_kernels.h
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_dot_product
+ * Purpose:   Compute the dot product of two distributed vectors
+ * In args:   local_x, local_y:  local blocks of the vectors
+ *            local_n:  order of the local blocks
+ *            comm:     communicator containing the calling processes
+ * Ret val:   The dot product on process 0, 0 on the other processes
+ */
+double Parallel_dot_product(
+      double    local_x[]  /* in */,
+      double    local_y[]  /* in */,
+      int       local_n    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double local_dot, dot = 0.0;
+
+   local_dot = Dot_product(local_x, local_y, local_n);
+   MPI_Reduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   return dot;
+}  /* Parallel_dot_product */
@@ -0,0 +1,394 @@
+/* File:     lab3_output.c
+ *
+ * Purpose:  The output modes of the vector addition programs:  show
+ *           a block distributed vector as its first and last elements,
+ *           its sum or its CRC32C, without gathering it to process 0.
+ *
+ * Compile:  mpicc -O3 -Wall -c lab3_output.c
+ *
+ * Notes:
+ * 1.  See lab3_output.h
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <mpi.h>
+#include "lab3_output.h"
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+/* CRC32C (Castagnoli) polynomial, reflected */
+#define CRC32C_POLY 0x82f63b78u
+
+/* Tables for Crc32c and Crc32c_combine:  set by Crc32c_init */
+static uint32_t crc32c_table[8][256];
+static uint32_t x2n_table[32];
+
+/*-------------------------------------------------------------------
+ * Function:  Get_output_mode
+ * Purpose:   Convert the name of an output mode, the argument of -o
+ * In arg:    name:    none, headtail, checksum, hash or full
+ * Out arg:   mode_p:  the mode, unchanged if name isn't recognized
+ * Ret val:   1 if name is recognized, 0 otherwise
+ */
+int Get_output_mode(
+      char            name[]  /* in  */,
+      output_mode_t*  mode_p  /* out */) {
+
+   if (strcmp(name, "none") == 0) *mode_p = OUTPUT_NONE;
+   else if (strcmp(name, "headtail") == 0) *mode_p = OUTPUT_HEAD_TAIL;
+   else if (strcmp(name, "checksum") == 0) *mode_p = OUTPUT_CHECKSUM;
+   else if (strcmp(name, "hash") == 0) *mode_p = OUTPUT_HASH;
+   else if (strcmp(name, "full") == 0) *mode_p = OUTPUT_FULL;
+   else return 0;
+   return 1;
+}  /* Get_output_mode */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Output_modes_usage
+ * Purpose:   Print the output modes for a usage message
+ */
+void Output_modes_usage(void) {
+   fprintf(stderr, "   mode:  none      print nothing\n");
+   fprintf(stderr, "          headtail  first and last %d elements\n",
+         HEAD_TAIL_COUNT);
+   fprintf(stderr, "          checksum  sum of the elements\n");
+   fprintf(stderr, "          hash      CRC32C of the elements\n");
+   fprintf(stderr, "          full      all the elements\n");
+}  /* Output_modes_usage */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Output_vector
+ * Purpose:   Show a vector that has a block distribution in the
+ *            selected output mode
+ * In args:   local_b:  local storage for vector to be shown
+ *            local_n:  order of local vectors
+ *            n:        order of global vector (local_n*comm_sz)
+ *            title:    title to precede print out
+ *            mode:     output mode
+ *            print_full:  the program's Print_vector, used in the
+ *                      full mode
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ */
+void Output_vector(
+      double         local_b[]  /* in */,
+      int            local_n    /* in */,
+      int            n          /* in */,
+      char           title[]    /* in */,
+      output_mode_t  mode       /* in */,
+      print_vector_t print_full /* in */,
+      int            my_rank    /* in */,
+      MPI_Comm       comm       /* in */) {
+   switch (mode) {
+      case OUTPUT_HEAD_TAIL:
+         Print_head_tail(local_b, local_n, n, HEAD_TAIL_COUNT, title,
+               my_rank, comm);
+         break;
+      case OUTPUT_CHECKSUM:
+         Print_checksum(local_b, local_n, title, my_rank, comm);
+         break;
+      case OUTPUT_HASH:
+         Print_hash(local_b, local_n, title, my_rank, comm);
+         break;
+      case OUTPUT_FULL:
+         print_full(local_b, local_n, n, title, my_rank, comm);
+         break;
+      default:
+         break;
+   }
+}  /* Output_vector */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_head_tail
+ * Purpose:   Print the first and the last count elements of a vector
+ *            that has a block distribution.  Only the processes that
+ *            own some of those elements send them to process 0, so
+ *            at most 2*count elements are communicated.
+ * In args:   local_b:  local storage for vector to be printed
+ *            local_n:  order of local vectors
+ *            n:        order of global vector (local_n*comm_sz)
+ *            count:    number of elements to print at each end
+ *            title:    title to precede print out
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ *
+ * Note:      If n <= 2*count the whole vector is printed once.
+ */
+void Print_head_tail(
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      int       n          /* in */,
+      int       count      /* in */,
+      char      title[]    /* in */,
+      int       my_rank    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double buf[2*HEAD_TAIL_COUNT];
+   int first[2], last[2];   /* the two ranges [first, last) */
+   int r, q, lo, hi, comm_sz, i;
+
+   if (count > HEAD_TAIL_COUNT) count = HEAD_TAIL_COUNT;
+   MPI_Comm_size(comm, &comm_sz);
+   /* Elements past local_n*comm_sz aren't stored on any process */
+   if (n > local_n*comm_sz) n = local_n*comm_sz;
+   first[0] = 0;
+   last[0] = count < n ? count : n;
+   first[1] = n - count > last[0] ? n - count : last[0];
+   last[1] = n;
+
+   for (r = 0; r < 2; r++)
+      for (q = 0; q < comm_sz; q++) {
+         lo = first[r] > q*local_n ? first[r] : q*local_n;
+         hi = last[r] < (q + 1)*local_n ? last[r] : (q + 1)*local_n;
+         if (lo >= hi) continue;
+         if (my_rank == 0 && q == 0)
+            memcpy(buf + r*count + lo - first[r], local_b + lo,
+                  (hi - lo)*sizeof(double));
+         else if (my_rank == 0)
+            MPI_Recv(buf + r*count + lo - first[r], hi - lo, MPI_DOUBLE,
+                  q, 0, comm, MPI_STATUS_IGNORE);
+         else if (my_rank == q)
+            MPI_Send(local_b + lo - q*local_n, hi - lo, MPI_DOUBLE, 0, 0,
+                  comm);
+      }
+
+   if (my_rank == 0) {
+      if (last[1] > first[1]) {
+         printf("%s (primeros %d):\n", title, last[0]);
+         for (i = 0; i < last[0]; i++)
+            printf("%f ", buf[i]);
+         printf("\n");
+         printf("%s (últimos %d):\n", title, last[1] - first[1]);
+         for (i = 0; i < last[1] - first[1]; i++)
+            printf("%f ", buf[count + i]);
+      } else {
+         printf("%s:\n", title);
+         for (i = 0; i < last[0]; i++)
+            printf("%f ", buf[i]);
+      }
+      printf("\n");
+   }
+}  /* Print_head_tail */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_checksum
+ * Purpose:   Print the sum of the elements of a vector that has a
+ *            block distribution.  Only one double per process is
+ *            communicated.
+ * In args:   local_b:  local storage for the vector
+ *            local_n:  order of local vectors
+ *            title:    title to precede print out
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ */
+void Print_checksum(
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      char      title[]    /* in */,
+      int       my_rank    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double local_sum = 0.0, sum = 0.0;
+   int local_i;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_sum += local_b[local_i];
+   MPI_Reduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   if (my_rank == 0)
+      printf("%s (suma): %f\n", title, sum);
+}  /* Print_checksum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Crc32c_init
+ * Purpose:   Build the tables used by the software CRC32C and by
+ *            Crc32c_combine.  Only the first call does any work.
+ */
+void Crc32c_init(void) {
+   static int initialized = 0;
+   uint32_t c;
+   int i, k;
+
+   if (initialized) return;
+   for (i = 0; i < 256; i++) {
+      c = i;
+      for (k = 0; k < 8; k++)
+         c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+      crc32c_table[0][i] = c;
+   }
+   for (i = 0; i < 256; i++)
+      for (k = 1; k < 8; k++)
+         crc32c_table[k][i] = (crc32c_table[k-1][i] >> 8) ^
+               crc32c_table[0][crc32c_table[k-1][i] & 0xff];
+
+   /* x2n_table[k] = x^(2^k) mod P */
+   x2n_table[0] = (uint32_t) 1 << 30;
+   for (k = 1; k < 32; k++)
+      x2n_table[k] = Multmodp(x2n_table[k-1], x2n_table[k-1]);
+   initialized = 1;
+}  /* Crc32c_init */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Crc32c
+ * Purpose:   Update a CRC32C (Castagnoli) with len more bytes
+ * In args:   crc:  CRC of the preceding bytes (0 for none)
+ *            buf:  the bytes
+ *            len:  number of bytes
+ * Ret val:   CRC of the preceding bytes followed by buf
+ *
+ * Note:      With SSE4.2 (e.g., -march=native on x86-64) the crc32
+ *            instruction processes 8 bytes at a time.  Otherwise a
+ *            table driven version processes 8 bytes per step.
+ */
+uint32_t Crc32c(
+      uint32_t     crc  /* in */,
+      const void*  buf  /* in */,
+      size_t       len  /* in */) {
+   const unsigned char* p = buf;
+   uint64_t c = ~crc & 0xffffffffu, word;
+
+#  ifdef __SSE4_2__
+   while (len >= 8) {
+      memcpy(&word, p, 8);
+      c = _mm_crc32_u64(c, word);
+      p += 8;
+      len -= 8;
+   }
+   while (len-- > 0)
+      c = _mm_crc32_u8((uint32_t) c, *p++);
+#  else
+   while (len >= 8) {
+      memcpy(&word, p, 8);   /* little-endian load */
+      word ^= c;
+      c = crc32c_table[7][word & 0xff] ^
+          crc32c_table[6][(word >> 8) & 0xff] ^
+          crc32c_table[5][(word >> 16) & 0xff] ^
+          crc32c_table[4][(word >> 24) & 0xff] ^
+          crc32c_table[3][(word >> 32) & 0xff] ^
+          crc32c_table[2][(word >> 40) & 0xff] ^
+          crc32c_table[1][(word >> 48) & 0xff] ^
+          crc32c_table[0][word >> 56];
+      p += 8;
+      len -= 8;
+   }
+   while (len-- > 0)
+      c = crc32c_table[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+#  endif
+   return ~(uint32_t) c;
+}  /* Crc32c */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Multmodp
+ * Purpose:   Multiply two polynomials modulo the CRC32C polynomial
+ *            (reflected bit order, as in zlib's crc32_combine)
+ */
+uint32_t Multmodp(uint32_t a, uint32_t b) {
+   uint32_t m = (uint32_t) 1 << 31, p = 0;
+
+   for (;;) {
+      if (a & m) {
+         p ^= b;
+         if ((a & (m - 1)) == 0) break;
+      }
+      m >>= 1;
+      b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+   }
+   return p;
+}  /* Multmodp */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Crc32c_combine
+ * Purpose:   Compute the CRC of the concatenation A B from the CRCs
+ *            of A and B and the length of B
+ * In args:   crc1:  CRC of A
+ *            crc2:  CRC of B
+ *            len2:  number of bytes in B
+ * Ret val:   CRC of A B
+ */
+uint32_t Crc32c_combine(
+      uint32_t  crc1  /* in */,
+      uint32_t  crc2  /* in */,
+      uint64_t  len2  /* in */) {
+   uint32_t p = (uint32_t) 1 << 31;   /* x^0 */
+   int k = 3;                         /* x^(8*len2) = x^(len2*2^3) */
+
+   while (len2) {
+      if (len2 & 1) p = Multmodp(x2n_table[k & 31], p);
+      len2 >>= 1;
+      k++;
+   }
+   return Multmodp(p, crc1) ^ crc2;
+}  /* Crc32c_combine */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Hash_op_fn
+ * Purpose:   MPI_User_function combining (crc, length) pairs of
+ *            consecutive pieces of a vector:  inout = in followed by
+ *            inout.  Since the operator isn't commutative, MPI
+ *            applies it in rank order.
+ */
+void Hash_op_fn(
+      void*          in     /* in     */,
+      void*          inout  /* in/out */,
+      int*           len    /* in     */,
+      MPI_Datatype*  type   /* in     */) {
+   uint64_t* a = in;
+   uint64_t* b = inout;
+   int i;
+
+   for (i = 0; i < *len; i++, a += 2, b += 2) {
+      b[0] = Crc32c_combine((uint32_t) a[0], (uint32_t) b[0], b[1]);
+      b[1] += a[1];
+   }
+}  /* Hash_op_fn */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_hash
+ * Purpose:   Print the CRC32C of the bytes of a vector that has a
+ *            block distribution.  Each process hashes its block and
+ *            the (crc, length) pairs are combined in rank order by a
+ *            single MPI_Reduce, so the digest is the CRC of the whole
+ *            vector and doesn't depend on comm_sz.
+ * In args:   local_b:  local storage for the vector
+ *            local_n:  order of local vectors
+ *            title:    title to precede print out
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ */
+void Print_hash(
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      char      title[]    /* in */,
+      int       my_rank    /* in */,
+      MPI_Comm  comm       /* in */) {
+   uint64_t local_h[2], h[2];
+   MPI_Datatype pair_type;
+   MPI_Op hash_op;
+
+   Crc32c_init();
+   local_h[1] = (uint64_t) local_n*sizeof(double);
+   local_h[0] = Crc32c(0, local_b, local_h[1]);
+
+   MPI_Type_contiguous(2, MPI_UINT64_T, &pair_type);
+   MPI_Type_commit(&pair_type);
+   MPI_Op_create(Hash_op_fn, 0, &hash_op);
+   MPI_Reduce(local_h, h, 1, pair_type, hash_op, 0, comm);
+   MPI_Op_free(&hash_op);
+   MPI_Type_free(&pair_type);
+
+   if (my_rank == 0)
+      printf("%s (crc32c): %08x (%llu bytes)\n", title, (unsigned) h[0],
+            (unsigned long long) h[1]);
+}  /* Print_hash */
+
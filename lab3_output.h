@@ -0,0 +1,50 @@
+/* File:     lab3_output.h
+ *
+ * Purpose:  Declarations of the output modes shared by mpi_vector_add
+ *           and mpi_vector_add2
+ *
+ * Compile:  Link with lab3_output.c
+ *
+ * Notes:
+ * 1.  Output_vector takes the program's Print_vector for the full
+ *     mode, the only one that gathers the vector to process 0, so each
+ *     program keeps its own allocation of the gathered vector.
+ * 2.  The hash is the CRC32C of the whole vector, so it doesn't depend
+ *     on comm_sz.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#ifndef LAB3_OUTPUT_H
+#define LAB3_OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mpi.h>
+
+/* Number of elements shown at each end in the headtail output mode */
+#define HEAD_TAIL_COUNT 10
+
+typedef enum {OUTPUT_NONE, OUTPUT_HEAD_TAIL, OUTPUT_CHECKSUM,
+      OUTPUT_HASH, OUTPUT_FULL} output_mode_t;
+
+typedef void (*print_vector_t)(double local_b[], int local_n, int n,
+      char title[], int my_rank, MPI_Comm comm);
+
+int Get_output_mode(char name[], output_mode_t* mode_p);
+void Output_modes_usage(void);
+void Output_vector(double local_b[], int local_n, int n, char title[],
+      output_mode_t mode, print_vector_t print_full, int my_rank,
+      MPI_Comm comm);
+void Print_head_tail(double local_b[], int local_n, int n, int count,
+      char title[], int my_rank, MPI_Comm comm);
+void Print_checksum(double local_b[], int local_n, char title[],
+      int my_rank, MPI_Comm comm);
+void Crc32c_init(void);
+uint32_t Crc32c(uint32_t crc, const void* buf, size_t len);
+uint32_t Multmodp(uint32_t a, uint32_t b);
+uint32_t Crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+void Hash_op_fn(void* in, void* inout, int* len, MPI_Datatype* type);
+void Print_hash(double local_b[], int local_n, char title[], int my_rank,
+      MPI_Comm comm);
+
+#endif
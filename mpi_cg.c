@@ -0,0 +1,520 @@
+/* File:     mpi_cg.c
+ *
+ * Purpose:  Solve A x = b with the conjugate gradient method on
+ *           block distributed vectors.  Two versions are run on the
+ *           same system:
+ *
+ *           - classic CG, in which each iteration does two blocking
+ *             MPI_Allreduce calls for its dot products, and
+ *           - pipelined CG (Ghysels and Vanroose, 2014), in which the
+ *             two dot products of an iteration are combined in one
+ *             MPI_Iallreduce that is overlapped with the
+ *             matrix-vector product.
+ *
+ *           A is the tridiagonal matrix with 2+shift on the diagonal
+ *           and -1 off the diagonal (a shifted 1D Laplacian), so the
+ *           matrix-vector product only needs one value from each
+ *           neighboring process.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_cg mpi_cg.c lab3_kernels.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_cg [<n> [<max_iter> [<tol> [<shift>]]]]
+ *
+ * Input:    Optional command line args: the order of the system n
+ *           (default 1000000), the maximum number of iterations
+ *           (default 500), the relative residual tolerance (default
+ *           1e-8) and the diagonal shift (default 0.01)
+ * Output:   For each version:  iterations, final relative residual
+ *           ||b - A x||/||b||, total and per-iteration time, and the
+ *           time spent waiting for the reductions.  For the pipelined
+ *           version the fraction of the classic version's reduction
+ *           time that was hidden behind the matrix-vector product.
+ *
+ * Notes:
+ * 1.  The order of the system, n, should be evenly divisible
+ *     by comm_sz
+ * 2.  Times are the maximum over the processes.
+ * 3.  Pipelined CG tests convergence on the residual of the previous
+ *     iteration, so it may take one more iteration than classic CG.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* max_iter_p,
+      double* tol_p, double* shift_p, int comm_sz, MPI_Comm comm);
+double Parallel_norm(double local_x[], int local_n, MPI_Comm comm);
+void Axpy(double alpha, const double x[], double y[], int n);
+void Xpby(const double x[], double beta, double y[], int n);
+void Mat_vect_mult(double local_x[], double local_y[], int local_n,
+      double shift, int my_rank, int comm_sz, MPI_Comm comm);
+int Cg(double local_b[], double local_x[], int local_n, int max_iter,
+      double tol, double shift, int my_rank, int comm_sz,
+      double* wait_p, MPI_Comm comm);
+int Pipelined_cg(double local_b[], double local_x[], int local_n,
+      int max_iter, double tol, double shift, int my_rank, int comm_sz,
+      double* wait_p, MPI_Comm comm);
+double Relative_residual(double local_b[], double local_x[],
+      int local_n, double shift, int my_rank, int comm_sz,
+      MPI_Comm comm);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, local_n, local_i, max_iter, iters[2];
+   int comm_sz, my_rank;
+   double tol, shift, res[2];
+   double *local_b, *local_x;
+   double start, finish, loc_elapsed, elapsed[2], loc_wait, wait[2];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &max_iter, &tol, &shift, comm_sz, comm);
+   local_n = n/comm_sz;
+
+   local_b = malloc(local_n*sizeof(double));
+   local_x = malloc(local_n*sizeof(double));
+   Check_for_error(local_b != NULL && local_x != NULL, "main",
+         "Can't allocate local vector(s)", comm);
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_b[local_i] = 1.0;
+
+   /* Classic CG */
+   memset(local_x, 0, local_n*sizeof(double));
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   iters[0] = Cg(local_b, local_x, local_n, max_iter, tol, shift,
+         my_rank, comm_sz, &loc_wait, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   MPI_Reduce(&loc_wait, &wait[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   res[0] = Relative_residual(local_b, local_x, local_n, shift, my_rank,
+         comm_sz, comm);
+
+   /* Pipelined CG */
+   memset(local_x, 0, local_n*sizeof(double));
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   iters[1] = Pipelined_cg(local_b, local_x, local_n, max_iter, tol,
+         shift, my_rank, comm_sz, &loc_wait, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   MPI_Reduce(&loc_wait, &wait[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   res[1] = Relative_residual(local_b, local_x, local_n, shift, my_rank,
+         comm_sz, comm);
+
+   if (my_rank == 0) {
+      printf("n = %d, shift = %g, tol = %g, comm_sz = %d\n", n, shift,
+            tol, comm_sz);
+      printf("Classic   CG: %4d iters, residual %e, %f ms, "
+            "%f ms/iter, reductions %f ms/iter\n", iters[0], res[0],
+            elapsed[0]*1000, elapsed[0]*1000/iters[0],
+            wait[0]*1000/iters[0]);
+      printf("Pipelined CG: %4d iters, residual %e, %f ms, "
+            "%f ms/iter, waiting    %f ms/iter\n", iters[1], res[1],
+            elapsed[1]*1000, elapsed[1]*1000/iters[1],
+            wait[1]*1000/iters[1]);
+      printf("Reduction time hidden by pipelining: %.1f%%\n",
+            wait[0] > 0.0 ?
+            100.0*(1.0 - (wait[1]/iters[1])/(wait[0]/iters[0])) : 0.0);
+   }
+
+   free(local_b);
+   free(local_x);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the system and the solver parameters
+ *            from the command line
+ * In args:   argc, argv:  command line
+ *            comm_sz, comm:  usual MPI values
+ * Out args:  n_p:         order of the system
+ *            max_iter_p:  maximum number of iterations
+ *            tol_p:       relative residual tolerance
+ *            shift_p:     diagonal shift of A
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            max_iter and shift should be positive
+ */
+void Get_args(
+      int       argc        /* in  */,
+      char*     argv[]      /* in  */,
+      int*      n_p         /* out */,
+      int*      max_iter_p  /* out */,
+      double*   tol_p       /* out */,
+      double*   shift_p     /* out */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   int local_ok = 1;
+
+   *n_p = 1000000;
+   *max_iter_p = 500;
+   *tol_p = 1.0e-8;
+   *shift_p = 0.01;
+   if (argc > 1) *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *max_iter_p = strtol(argv[2], NULL, 10);
+   if (argc > 3) *tol_p = strtod(argv[3], NULL);
+   if (argc > 4) *shift_p = strtod(argv[4], NULL);
+
+   if (*n_p <= 0 || *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*max_iter_p <= 0 || *shift_p <= 0.0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "max_iter and shift should be > 0", comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_norm
+ * Purpose:   Compute the 2-norm of a distributed vector on every
+ *            process
+ * In args:   local_x:  local block of the vector
+ *            local_n:  order of the local block
+ *            comm:     communicator containing the calling processes
+ * Ret val:   ||x||_2
+ */
+double Parallel_norm(
+      double    local_x[]  /* in */,
+      int       local_n    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double local_dot, dot;
+
+   local_dot = Dot_product(local_x, local_x, local_n);
+   MPI_Allreduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, comm);
+   return sqrt(dot);
+}  /* Parallel_norm */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Axpy
+ * Purpose:   y = alpha*x + y
+ * In args:   alpha, x, n
+ * In/out arg:  y
+ */
+void Axpy(
+      double        alpha  /* in     */,
+      const double  x[]    /* in     */,
+      double        y[]    /* in/out */,
+      int           n      /* in     */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      y[i] += alpha*x[i];
+}  /* Axpy */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Xpby
+ * Purpose:   y = x + beta*y
+ * In args:   x, beta, n
+ * In/out arg:  y
+ */
+void Xpby(
+      const double  x[]    /* in     */,
+      double        beta   /* in     */,
+      double        y[]    /* in/out */,
+      int           n      /* in     */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      y[i] = x[i] + beta*y[i];
+}  /* Xpby */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Mat_vect_mult
+ * Purpose:   Compute y = A*x for the shifted 1D Laplacian A.  The
+ *            values of x just outside the local block are exchanged
+ *            with the neighboring processes while the interior of
+ *            the block is computed.
+ * In args:   local_x:  local block of x
+ *            local_n:  order of the local blocks
+ *            shift:    diagonal shift of A
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Out arg:   local_y:  local block of y
+ */
+void Mat_vect_mult(
+      double    local_x[]  /* in  */,
+      double    local_y[]  /* out */,
+      int       local_n    /* in  */,
+      double    shift      /* in  */,
+      int       my_rank    /* in  */,
+      int       comm_sz    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   int local_i, nreq = 0;
+   int left = my_rank > 0 ? my_rank - 1 : MPI_PROC_NULL;
+   int right = my_rank < comm_sz - 1 ? my_rank + 1 : MPI_PROC_NULL;
+   double x_left = 0.0, x_right = 0.0, d = 2.0 + shift;
+   MPI_Request req[4];
+
+   MPI_Irecv(&x_left, 1, MPI_DOUBLE, left, 0, comm, &req[nreq++]);
+   MPI_Irecv(&x_right, 1, MPI_DOUBLE, right, 0, comm, &req[nreq++]);
+   MPI_Isend(&local_x[0], 1, MPI_DOUBLE, left, 0, comm, &req[nreq++]);
+   MPI_Isend(&local_x[local_n-1], 1, MPI_DOUBLE, right, 0, comm,
+         &req[nreq++]);
+
+   for (local_i = 1; local_i < local_n - 1; local_i++)
+      local_y[local_i] = d*local_x[local_i] - local_x[local_i-1]
+            - local_x[local_i+1];
+
+   MPI_Waitall(nreq, req, MPI_STATUSES_IGNORE);
+   if (local_n == 1) {
+      local_y[0] = d*local_x[0] - x_left - x_right;
+   } else {
+      local_y[0] = d*local_x[0] - x_left - local_x[1];
+      local_y[local_n-1] = d*local_x[local_n-1] - local_x[local_n-2]
+            - x_right;
+   }
+}  /* Mat_vect_mult */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Cg
+ * Purpose:   Classic conjugate gradient
+ * In args:   local_b:   local block of the right-hand side
+ *            local_n:   order of the local blocks
+ *            max_iter, tol, shift:  solver parameters
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * In/out arg:  local_x:  on input the initial guess, on output the
+ *            approximate solution
+ * Out arg:   wait_p:  time spent in MPI_Allreduce
+ * Ret val:   Number of iterations
+ */
+int Cg(
+      double    local_b[]  /* in     */,
+      double    local_x[]  /* in/out */,
+      int       local_n    /* in     */,
+      int       max_iter   /* in     */,
+      double    tol        /* in     */,
+      double    shift      /* in     */,
+      int       my_rank    /* in     */,
+      int       comm_sz    /* in     */,
+      double*   wait_p     /* out    */,
+      MPI_Comm  comm       /* in     */) {
+   int iter, local_ok = 1;
+   double *r, *p, *ap;
+   double local_dot, rr, rr_old, pap, alpha, b_norm, start;
+
+   r = malloc(local_n*sizeof(double));
+   p = malloc(local_n*sizeof(double));
+   ap = malloc(local_n*sizeof(double));
+   if (r == NULL || p == NULL || ap == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Cg", "Can't allocate work vectors", comm);
+
+   *wait_p = 0.0;
+   b_norm = Parallel_norm(local_b, local_n, comm);
+
+   /* r = b - A x, p = r */
+   Mat_vect_mult(local_x, r, local_n, shift, my_rank, comm_sz, comm);
+   Xpby(local_b, -1.0, r, local_n);
+   memcpy(p, r, local_n*sizeof(double));
+   local_dot = Dot_product(r, r, local_n);
+   MPI_Allreduce(&local_dot, &rr, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+   for (iter = 0; iter < max_iter && sqrt(rr) > tol*b_norm; iter++) {
+      Mat_vect_mult(p, ap, local_n, shift, my_rank, comm_sz, comm);
+
+      local_dot = Dot_product(p, ap, local_n);
+      start = MPI_Wtime();
+      MPI_Allreduce(&local_dot, &pap, 1, MPI_DOUBLE, MPI_SUM, comm);
+      *wait_p += MPI_Wtime() - start;
+
+      alpha = rr/pap;
+      Axpy(alpha, p, local_x, local_n);
+      Axpy(-alpha, ap, r, local_n);
+
+      rr_old = rr;
+      local_dot = Dot_product(r, r, local_n);
+      start = MPI_Wtime();
+      MPI_Allreduce(&local_dot, &rr, 1, MPI_DOUBLE, MPI_SUM, comm);
+      *wait_p += MPI_Wtime() - start;
+
+      Xpby(r, rr/rr_old, p, local_n);
+   }
+
+   free(r);
+   free(p);
+   free(ap);
+   return iter;
+}  /* Cg */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Pipelined_cg
+ * Purpose:   Pipelined conjugate gradient (Ghysels and Vanroose,
+ *            unpreconditioned).  The two dot products of an
+ *            iteration are reduced together by one MPI_Iallreduce,
+ *            which is completed only after the next matrix-vector
+ *            product has been computed.
+ * In args:   local_b:   local block of the right-hand side
+ *            local_n:   order of the local blocks
+ *            max_iter, tol, shift:  solver parameters
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * In/out arg:  local_x:  on input the initial guess, on output the
+ *            approximate solution
+ * Out arg:   wait_p:  time spent in MPI_Wait for the reductions
+ * Ret val:   Number of iterations
+ */
+int Pipelined_cg(
+      double    local_b[]  /* in     */,
+      double    local_x[]  /* in/out */,
+      int       local_n    /* in     */,
+      int       max_iter   /* in     */,
+      double    tol        /* in     */,
+      double    shift      /* in     */,
+      int       my_rank    /* in     */,
+      int       comm_sz    /* in     */,
+      double*   wait_p     /* out    */,
+      MPI_Comm  comm       /* in     */) {
+   int iter, local_ok = 1;
+   double *r, *w, *p, *s, *z, *q;
+   double local_dots[2], dots[2];
+   double gamma, gamma_old = 0.0, delta, alpha = 0.0, beta;
+   double b_norm, start;
+   MPI_Request req;
+
+   r = malloc(local_n*sizeof(double));
+   w = malloc(local_n*sizeof(double));
+   p = calloc(local_n, sizeof(double));
+   s = calloc(local_n, sizeof(double));
+   z = calloc(local_n, sizeof(double));
+   q = malloc(local_n*sizeof(double));
+   if (r == NULL || w == NULL || p == NULL || s == NULL || z == NULL ||
+         q == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Pipelined_cg",
+         "Can't allocate work vectors", comm);
+
+   *wait_p = 0.0;
+   b_norm = Parallel_norm(local_b, local_n, comm);
+
+   /* r = b - A x, w = A r */
+   Mat_vect_mult(local_x, r, local_n, shift, my_rank, comm_sz, comm);
+   Xpby(local_b, -1.0, r, local_n);
+   Mat_vect_mult(r, w, local_n, shift, my_rank, comm_sz, comm);
+
+   for (iter = 0; iter < max_iter; iter++) {
+      local_dots[0] = Dot_product(r, r, local_n);
+      local_dots[1] = Dot_product(w, r, local_n);
+      MPI_Iallreduce(local_dots, dots, 2, MPI_DOUBLE, MPI_SUM, comm,
+            &req);
+
+      /* q = A w overlaps the reduction */
+      Mat_vect_mult(w, q, local_n, shift, my_rank, comm_sz, comm);
+
+      start = MPI_Wtime();
+      MPI_Wait(&req, MPI_STATUS_IGNORE);
+      *wait_p += MPI_Wtime() - start;
+
+      gamma = dots[0];
+      delta = dots[1];
+      if (sqrt(gamma) <= tol*b_norm) break;
+      if (iter > 0) {
+         beta = gamma/gamma_old;
+         alpha = gamma/(delta - beta*gamma/alpha);
+      } else {
+         beta = 0.0;
+         alpha = gamma/delta;
+      }
+      gamma_old = gamma;
+
+      Xpby(q, beta, z, local_n);
+      Xpby(w, beta, s, local_n);
+      Xpby(r, beta, p, local_n);
+      Axpy(alpha, p, local_x, local_n);
+      Axpy(-alpha, s, r, local_n);
+      Axpy(-alpha, z, w, local_n);
+   }
+
+   free(r);
+   free(w);
+   free(p);
+   free(s);
+   free(z);
+   free(q);
+   return iter;
+}  /* Pipelined_cg */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Relative_residual
+ * Purpose:   Compute ||b - A x||/||b|| on every process
+ * In args:   local_b, local_x:  local blocks of b and x
+ *            local_n:  order of the local blocks
+ *            shift:    diagonal shift of A
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Ret val:   The relative residual
+ */
+double Relative_residual(
+      double    local_b[]  /* in */,
+      double    local_x[]  /* in */,
+      int       local_n    /* in */,
+      double    shift      /* in */,
+      int       my_rank    /* in */,
+      int       comm_sz    /* in */,
+      MPI_Comm  comm       /* in */) {
+   int local_ok = 1;
+   double res;
+   double* r = malloc(local_n*sizeof(double));
+
+   if (r == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Relative_residual",
+         "Can't allocate work vector", comm);
+   Mat_vect_mult(local_x, r, local_n, shift, my_rank, comm_sz, comm);
+   Xpby(local_b, -1.0, r, local_n);
+   res = Parallel_norm(r, local_n, comm)/
+         Parallel_norm(local_b, local_n, comm);
+   free(r);
+   return res;
+}  /* Relative_residual */
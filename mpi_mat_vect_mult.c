@@ -0,0 +1,394 @@
+/* File:     mpi_mat_vect_mult.c
+ *
+ * Purpose:  Implement parallel matrix-vector multiplication y = A*x
+ *           using a block distribution of the rows of A and block
+ *           distributions of x and y (the layout used by Read_vector
+ *           in mpi_vector_add.c).  A dense and a CSR (compressed
+ *           sparse row) version of A are multiplied by the same x.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_mat_vect_mult mpi_mat_vect_mult.c \
+ *              lab3_kernels.c lab3_kernels_mpi.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_mat_vect_mult [<m> [<n> [<density>]]]
+ *
+ * Input:    Optional command line args: the number of rows m and of
+ *           columns n of A (default 4000 x 4000) and the fraction of
+ *           nonzero entries of A (default 0.05)
+ * Output:   Run time of the gather of x, of the dense and of the CSR
+ *           products, and the maximum difference between the dense
+ *           and the CSR results.
+ *
+ * Notes:
+ * 1.  m and n should be evenly divisible by comm_sz
+ * 2.  Each process gathers all of x with MPI_Allgather before
+ *     multiplying its block of rows.
+ * 3.  The dense kernel blocks the columns so the piece of x being
+ *     used stays in cache while the rows of the block sweep over it.
+ *     Each piece of row is handled by the Dot_product kernel of
+ *     lab3_kernels.c, the one used by Parallel_dot_product.
+ *
+ * IPP:  Section 3.4.9 (pp. 113 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+/* Columns per cache block of the dense kernel:  2048 doubles = 16 KB */
+#define BLOCK_COLS 2048
+
+typedef struct {
+   int      local_m;   /* number of local rows                   */
+   int*     row_ptr;   /* local_m+1 offsets into col_ind and val */
+   int*     col_ind;   /* global column indices                  */
+   double*  val;       /* nonzero values                         */
+} csr_matrix_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* m_p, int* n_p,
+      double* density_p, int comm_sz, MPI_Comm comm);
+void Generate_matrix(double local_A[], int local_m, int n,
+      double density);
+void Dense_to_csr(double local_A[], int local_m, int n,
+      csr_matrix_t* local_S_p, MPI_Comm comm);
+void Free_csr(csr_matrix_t* local_S_p);
+void Gather_x(double local_x[], double x[], int local_n, MPI_Comm comm);
+void Mat_vect_mult(double local_A[], double x[], double local_y[],
+      int local_m, int n);
+void Csr_mat_vect_mult(csr_matrix_t* local_S_p, double x[],
+      double local_y[]);
+double Max_diff(double local_a[], double local_b[], int local_n,
+      MPI_Comm comm);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int m, n, local_m, local_n, local_i;
+   int comm_sz, my_rank;
+   double density, diff, y_dot_y;
+   double *local_A, *local_x, *x, *local_y, *local_w;
+   csr_matrix_t local_S;
+   double start, finish, loc_elapsed, elapsed[3];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &m, &n, &density, comm_sz, comm);
+   local_m = m/comm_sz;
+   local_n = n/comm_sz;
+
+   local_A = malloc((size_t) local_m*n*sizeof(double));
+   local_x = malloc(local_n*sizeof(double));
+   x = malloc(n*sizeof(double));
+   local_y = malloc(local_m*sizeof(double));
+   local_w = malloc(local_m*sizeof(double));
+   Check_for_error(local_A != NULL && local_x != NULL && x != NULL &&
+         local_y != NULL && local_w != NULL, "main",
+         "Can't allocate local storage", comm);
+
+   srand(time(NULL) + my_rank);
+   Generate_matrix(local_A, local_m, n, density);
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_x[local_i] = (double)(rand() % 100);
+   Dense_to_csr(local_A, local_m, n, &local_S, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Gather_x(local_x, x, local_n, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Mat_vect_mult(local_A, x, local_y, local_m, n);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Csr_mat_vect_mult(&local_S, x, local_w);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[2], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   diff = Max_diff(local_y, local_w, local_m, comm);
+   y_dot_y = Parallel_dot_product(local_y, local_y, local_m, comm);
+
+   if (my_rank == 0) {
+      printf("m = %d, n = %d, density = %g, comm_sz = %d\n", m, n,
+            density, comm_sz);
+      printf("Allgather of x:   %f ms\n", elapsed[0]*1000);
+      printf("Dense  y = A*x:   %f ms (%.2f GFLOP/s)\n", elapsed[1]*1000,
+            2.0*m*n/elapsed[1]/1.0e9);
+      printf("CSR    y = A*x:   %f ms\n", elapsed[2]*1000);
+      printf("Max diff dense vs CSR = %e, ||y||^2 = %f\n", diff, y_dot_y);
+   }
+
+   Free_csr(&local_S);
+   free(local_A);
+   free(local_x);
+   free(x);
+   free(local_y);
+   free(local_w);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the dimensions of A and its density from the
+ *            command line
+ * In args:   argc, argv:  command line
+ *            comm_sz, comm:  usual MPI values
+ * Out args:  m_p, n_p:    number of rows and columns of A
+ *            density_p:   fraction of nonzero entries of A
+ *
+ * Errors:    m and n should be positive and evenly divisible by
+ *            comm_sz, and 0 < density <= 1
+ */
+void Get_args(
+      int       argc        /* in  */,
+      char*     argv[]      /* in  */,
+      int*      m_p         /* out */,
+      int*      n_p         /* out */,
+      double*   density_p   /* out */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   int local_ok = 1;
+
+   *m_p = *n_p = 4000;
+   *density_p = 0.05;
+   if (argc > 1) *m_p = *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *n_p = strtol(argv[2], NULL, 10);
+   if (argc > 3) *density_p = strtod(argv[3], NULL);
+
+   if (*m_p <= 0 || *n_p <= 0 || *m_p % comm_sz != 0 ||
+         *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "m and n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*density_p <= 0.0 || *density_p > 1.0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "density should be in (0, 1]", comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Generate_matrix
+ * Purpose:   Fill the local block of rows of A with random values,
+ *            each entry being nonzero with probability density
+ * In args:   local_m:  number of local rows
+ *            n:        number of columns
+ *            density:  fraction of nonzeros
+ * Out arg:   local_A:  local rows, stored in row-major order
+ */
+void Generate_matrix(
+      double  local_A[]  /* out */,
+      int     local_m    /* in  */,
+      int     n          /* in  */,
+      double  density    /* in  */) {
+   size_t ij;
+   int threshold = (int) (density*RAND_MAX);
+
+   for (ij = 0; ij < (size_t) local_m*n; ij++)
+      local_A[ij] = rand() <= threshold ? (double)(rand() % 10 + 1) : 0.0;
+}  /* Generate_matrix */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Dense_to_csr
+ * Purpose:   Build the CSR form of the local block of rows of A
+ * In args:   local_A:  local rows, row-major
+ *            local_m:  number of local rows
+ *            n:        number of columns
+ *            comm:     communicator containing the calling processes
+ * Out arg:   local_S_p:  the CSR matrix
+ *
+ * Errors:    One or more of the calls to malloc fails
+ */
+void Dense_to_csr(
+      double         local_A[]  /* in  */,
+      int            local_m    /* in  */,
+      int            n          /* in  */,
+      csr_matrix_t*  local_S_p  /* out */,
+      MPI_Comm       comm       /* in  */) {
+   int local_i, j, nnz = 0, k;
+   size_t ij;
+   int local_ok = 1;
+
+   for (ij = 0; ij < (size_t) local_m*n; ij++)
+      if (local_A[ij] != 0.0) nnz++;
+
+   local_S_p->local_m = local_m;
+   local_S_p->row_ptr = malloc((local_m + 1)*sizeof(int));
+   local_S_p->col_ind = malloc((nnz + 1)*sizeof(int));
+   local_S_p->val = malloc((nnz + 1)*sizeof(double));
+   if (local_S_p->row_ptr == NULL || local_S_p->col_ind == NULL ||
+         local_S_p->val == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Dense_to_csr",
+         "Can't allocate CSR matrix", comm);
+
+   k = 0;
+   for (local_i = 0; local_i < local_m; local_i++) {
+      local_S_p->row_ptr[local_i] = k;
+      for (j = 0; j < n; j++)
+         if (local_A[(size_t) local_i*n + j] != 0.0) {
+            local_S_p->col_ind[k] = j;
+            local_S_p->val[k++] = local_A[(size_t) local_i*n + j];
+         }
+   }
+   local_S_p->row_ptr[local_m] = k;
+}  /* Dense_to_csr */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Free_csr
+ * Purpose:   Free the storage of a CSR matrix
+ * In/out arg:  local_S_p
+ */
+void Free_csr(csr_matrix_t* local_S_p  /* in/out */) {
+   free(local_S_p->row_ptr);
+   free(local_S_p->col_ind);
+   free(local_S_p->val);
+}  /* Free_csr */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Gather_x
+ * Purpose:   Collect the block distributed x on every process
+ * In args:   local_x:  local block of x
+ *            local_n:  order of the local block
+ *            comm:     communicator containing the calling processes
+ * Out arg:   x:        the full vector x
+ */
+void Gather_x(
+      double    local_x[]  /* in  */,
+      double    x[]        /* out */,
+      int       local_n    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   MPI_Allgather(local_x, local_n, MPI_DOUBLE, x, local_n, MPI_DOUBLE,
+         comm);
+}  /* Gather_x */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Mat_vect_mult
+ * Purpose:   Multiply the local block of rows of A by x
+ * In args:   local_A:  local rows of A, row-major
+ *            x:        the full vector x (see Gather_x)
+ *            local_m:  number of local rows
+ *            n:        number of columns
+ * Out arg:   local_y:  local block of y = A*x
+ */
+void Mat_vect_mult(
+      double  local_A[]  /* in  */,
+      double  x[]        /* in  */,
+      double  local_y[]  /* out */,
+      int     local_m    /* in  */,
+      int     n          /* in  */) {
+   int local_i, jb, cols;
+
+   for (local_i = 0; local_i < local_m; local_i++)
+      local_y[local_i] = 0.0;
+
+   for (jb = 0; jb < n; jb += BLOCK_COLS) {
+      cols = n - jb < BLOCK_COLS ? n - jb : BLOCK_COLS;
+      for (local_i = 0; local_i < local_m; local_i++)
+         local_y[local_i] += Dot_product(local_A + (size_t) local_i*n + jb,
+               x + jb, cols);
+   }
+}  /* Mat_vect_mult */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Csr_mat_vect_mult
+ * Purpose:   Multiply the local block of rows of a CSR matrix by x
+ * In args:   local_S_p:  local rows of A in CSR form
+ *            x:          the full vector x (see Gather_x)
+ * Out arg:   local_y:    local block of y = A*x
+ */
+void Csr_mat_vect_mult(
+      csr_matrix_t*  local_S_p  /* in  */,
+      double         x[]        /* in  */,
+      double         local_y[]  /* out */) {
+   const int* restrict row_ptr = local_S_p->row_ptr;
+   const int* restrict col_ind = local_S_p->col_ind;
+   const double* restrict val = local_S_p->val;
+   int local_i, k;
+   double sum;
+
+   for (local_i = 0; local_i < local_S_p->local_m; local_i++) {
+      sum = 0.0;
+      for (k = row_ptr[local_i]; k < row_ptr[local_i+1]; k++)
+         sum += val[k]*x[col_ind[k]];
+      local_y[local_i] = sum;
+   }
+}  /* Csr_mat_vect_mult */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Find the largest absolute difference between the
+ *            entries of two distributed vectors
+ * In args:   local_a, local_b:  local blocks of the vectors
+ *            local_n:  order of the local blocks
+ *            comm:     communicator containing the calling processes
+ * Ret val:   max |a[i] - b[i]| on process 0
+ */
+double Max_diff(
+      double    local_a[]  /* in */,
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      MPI_Comm  comm       /* in */) {
+   int local_i;
+   double local_max = 0.0, max = 0.0;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      if (fabs(local_a[local_i] - local_b[local_i]) > local_max)
+         local_max = fabs(local_a[local_i] - local_b[local_i]);
+   MPI_Reduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   return max;
+}  /* Max_diff */
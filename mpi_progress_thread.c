@@ -0,0 +1,430 @@
+/* File:     mpi_progress_thread.c
+ *
+ * Purpose:  Measure how well a nonblocking collective (MPI_Iscatter of
+ *           a vector, or MPI_Iallreduce of a block) overlaps the local
+ *           part of Parallel_vector_sum, with and without a progress
+ *           thread.  Many MPI libraries only advance a nonblocking
+ *           collective inside MPI calls, so without help it stalls
+ *           until the final MPI_Wait.  The optional progress thread of
+ *           each process calls into MPI in a loop while the main thread
+ *           computes.
+ *
+ * Compile:  mpicc -O3 -Wall -pthread -o mpi_progress_thread \
+ *              mpi_progress_thread.c lab3_kernels.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_progress_thread [-n <n>]
+ *                 [-p <poll us>]
+ *
+ * Input:    None
+ * Output:   For each collective:  the time of the communication alone,
+ *           of the computation alone, and of both overlapped without
+ *           and with the progress thread, with the overlap efficiency
+ *           of each
+ *
+ * Notes:
+ * 1.  n (default 4000000) is the order of the vectors and should be
+ *     evenly divisible by comm_sz.  The computation is repeated so it
+ *     takes about as long as the communication.
+ * 2.  The overlap efficiency is (comm + comp - overlapped)/min(comm,
+ *     comp):  1 when the shorter phase is completely hidden, 0 when
+ *     nothing is, and negative when overlapping costs more than running
+ *     the two back to back, e.g., when the processes share cores.
+ * 3.  The progress thread calls MPI_Iprobe on its own duplicate of the
+ *     communicator, which never matches a message but runs MPI's
+ *     progress engine, and never touches the main thread's requests.
+ *     It sleeps <poll us> microseconds between calls (default 0:  it
+ *     just yields).  It needs MPI_THREAD_MULTIPLE; without it only the
+ *     runs without the thread are made.
+ * 4.  With fewer cores than threads the progress thread competes with
+ *     the computation for the core, and a longer poll interval helps.
+ * 5.  Each time is the best of TRIALS runs.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+#define TRIALS 5
+
+typedef enum {OP_ISCATTER, OP_IALLREDUCE} op_t;
+
+typedef struct {
+   pthread_t   thread;
+   MPI_Comm    comm;
+   int         poll_us;
+   atomic_int  stop;
+} progress_t;
+
+typedef struct {
+   double*   x;        /* full vector, only on process 0 */
+   double*   local_x;
+   double*   local_y;
+   double*   local_z;
+   double*   local_w;  /* receives the scattered vector  */
+   double*   reduced;  /* receives the allreduce         */
+   int       local_n;
+   int       reps;     /* repetitions of the computation */
+   MPI_Comm  comm;
+} data_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* poll_us_p,
+      int comm_sz, MPI_Comm comm);
+void Allocate_data(data_t* d, int n, int local_n, int my_rank,
+      MPI_Comm comm);
+void Free_data(data_t* d);
+void Start_op(op_t op, data_t* d, MPI_Request* req_p);
+void Compute(data_t* d);
+double Time_comm(op_t op, data_t* d);
+double Time_comp(data_t* d);
+double Time_overlap(op_t op, data_t* d, int use_thread, int poll_us);
+void Progress_start(progress_t* p, MPI_Comm comm, int poll_us);
+void Progress_stop(progress_t* p);
+void* Progress_loop(void* p_p);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, poll_us, provided, op, local_i;
+   int comm_sz, my_rank;
+   double comm_t, comp_t, plain_t, thread_t = 0.0, hidden;
+   char* op_names[] = {"Iscatter", "Iallreduce"};
+   data_t d;
+   MPI_Comm comm;
+
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &poll_us, comm_sz, comm);
+   Allocate_data(&d, n, n/comm_sz, my_rank, comm);
+   for (local_i = 0; local_i < d.local_n; local_i++) {
+      d.local_x[local_i] = my_rank + local_i % 10;
+      d.local_y[local_i] = 1.0;
+   }
+   if (my_rank == 0) {
+      if (provided < MPI_THREAD_MULTIPLE)
+         printf("MPI_THREAD_MULTIPLE isn't available, "
+               "no progress thread\n");
+      printf("n = %d, comm_sz = %d, times in ms\n", n, comm_sz);
+      printf("%-10s %8s %8s %5s %10s %6s %10s %6s\n", "op", "comm",
+            "comp", "reps", "no thread", "eff", "thread", "eff");
+   }
+
+   for (op = OP_ISCATTER; op <= OP_IALLREDUCE; op++) {
+      comm_t = Time_comm(op, &d);
+      /* Make the computation take about as long as the communication */
+      d.reps = 1;
+      comp_t = Time_comp(&d);
+      d.reps = comp_t < comm_t ? (int) (comm_t/comp_t + 0.5) : 1;
+      MPI_Bcast(&d.reps, 1, MPI_INT, 0, comm);
+      comp_t = Time_comp(&d);
+
+      plain_t = Time_overlap(op, &d, 0, poll_us);
+      if (provided >= MPI_THREAD_MULTIPLE)
+         thread_t = Time_overlap(op, &d, 1, poll_us);
+
+      if (my_rank == 0) {
+         hidden = comm_t < comp_t ? comm_t : comp_t;
+         printf("%-10s %8.3f %8.3f %5d %10.3f %5.0f%%", op_names[op],
+               1000*comm_t, 1000*comp_t, d.reps, 1000*plain_t,
+               100*(comm_t + comp_t - plain_t)/hidden);
+         if (provided >= MPI_THREAD_MULTIPLE)
+            printf(" %10.3f %5.0f%%\n", 1000*thread_t,
+                  100*(comm_t + comp_t - thread_t)/hidden);
+         else
+            printf(" %10s %6s\n", "-", "-");
+      }
+   }
+
+   Free_data(&d);
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors and the poll interval of the
+ *            progress thread from the command line
+ * In args:   argc, argv, comm_sz, comm
+ * Out args:  n_p, poll_us_p
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz, and
+ *            poll us should be >= 0
+ */
+void Get_args(
+      int       argc       /* in  */,
+      char*     argv[]     /* in  */,
+      int*      n_p        /* out */,
+      int*      poll_us_p  /* out */,
+      int       comm_sz    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   int c, local_ok = 1;
+
+   *n_p = 4000000;
+   *poll_us_p = 0;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:p:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 'p': *poll_us_p = strtol(optarg, NULL, 10); break;
+         default:  local_ok = 0;
+      }
+   Check_for_error(local_ok, "Get_args",
+         "usage: mpi_progress_thread [-n <n>] [-p <poll us>]", comm);
+   Check_for_error(*n_p > 0 && *n_p % comm_sz == 0, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   Check_for_error(*poll_us_p >= 0, "Get_args",
+         "poll us should be >= 0", comm);
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:  Allocate_data
+ * Purpose:   Allocate the vectors of the experiment
+ * In args:   n, local_n, my_rank, comm
+ * Out arg:   d
+ *
+ * Errors:    malloc failure
+ */
+void Allocate_data(
+      data_t*   d        /* out */,
+      int       n        /* in  */,
+      int       local_n  /* in  */,
+      int       my_rank  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int i, local_ok = 1;
+
+   d->local_n = local_n;
+   d->reps = 1;
+   d->comm = comm;
+   d->x = NULL;
+   if (my_rank == 0) {
+      d->x = malloc(n*sizeof(double));
+      if (d->x == NULL) local_ok = 0;
+      else
+         for (i = 0; i < n; i++)
+            d->x[i] = i % 100;
+   }
+   d->local_x = malloc(local_n*sizeof(double));
+   d->local_y = malloc(local_n*sizeof(double));
+   d->local_z = calloc(local_n, sizeof(double));
+   d->local_w = calloc(local_n, sizeof(double));
+   d->reduced = calloc(local_n, sizeof(double));
+   if (d->local_x == NULL || d->local_y == NULL || d->local_z == NULL
+         || d->local_w == NULL || d->reduced == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Allocate_data", "Can't allocate vectors",
+         comm);
+}  /* Allocate_data */
+
+/*-------------------------------------------------------------------
+ * Function:  Free_data
+ * Purpose:   Free the vectors of the experiment
+ * In/out:    d
+ */
+void Free_data(data_t* d) {
+   free(d->x);
+   free(d->local_x);
+   free(d->local_y);
+   free(d->local_z);
+   free(d->local_w);
+   free(d->reduced);
+}  /* Free_data */
+
+/*-------------------------------------------------------------------
+ * Function:  Start_op
+ * Purpose:   Start the nonblocking collective op
+ * In args:   op, d
+ * Out arg:   req_p
+ * Note:      The buffers of the collectives aren't written by Compute,
+ *            so both can run at the same time.
+ */
+void Start_op(op_t op, data_t* d, MPI_Request* req_p) {
+   if (op == OP_ISCATTER)
+      MPI_Iscatter(d->x, d->local_n, MPI_DOUBLE, d->local_w, d->local_n,
+            MPI_DOUBLE, 0, d->comm, req_p);
+   else
+      MPI_Iallreduce(d->local_y, d->reduced, d->local_n, MPI_DOUBLE,
+            MPI_SUM, d->comm, req_p);
+}  /* Start_op */
+
+/*-------------------------------------------------------------------
+ * Function:  Compute
+ * Purpose:   Run Parallel_vector_sum d->reps times
+ * In/out:    d
+ */
+void Compute(data_t* d) {
+   int r;
+
+   for (r = 0; r < d->reps; r++)
+      Parallel_vector_sum(d->local_x, d->local_y, d->local_z, d->local_n);
+}  /* Compute */
+
+/*-------------------------------------------------------------------
+ * Function:  Time_comm
+ * Purpose:   Time the collective op alone
+ * In args:   op, d
+ * Ret val:   The best time over the processes' maximum
+ */
+double Time_comm(op_t op, data_t* d) {
+   int t;
+   double start, local_elapsed, elapsed, best = 1.0e30;
+   MPI_Request req;
+
+   for (t = 0; t < TRIALS; t++) {
+      MPI_Barrier(d->comm);
+      start = MPI_Wtime();
+      Start_op(op, d, &req);
+      MPI_Wait(&req, MPI_STATUS_IGNORE);
+      local_elapsed = MPI_Wtime() - start;
+      MPI_Allreduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+            d->comm);
+      if (elapsed < best) best = elapsed;
+   }
+   return best;
+}  /* Time_comm */
+
+/*-------------------------------------------------------------------
+ * Function:  Time_comp
+ * Purpose:   Time the computation alone
+ * In arg:    d
+ * Ret val:   The best time over the processes' maximum
+ */
+double Time_comp(data_t* d) {
+   int t;
+   double start, local_elapsed, elapsed, best = 1.0e30;
+
+   for (t = 0; t < TRIALS; t++) {
+      MPI_Barrier(d->comm);
+      start = MPI_Wtime();
+      Compute(d);
+      local_elapsed = MPI_Wtime() - start;
+      MPI_Allreduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+            d->comm);
+      if (elapsed < best) best = elapsed;
+   }
+   return best;
+}  /* Time_comp */
+
+/*-------------------------------------------------------------------
+ * Function:  Time_overlap
+ * Purpose:   Time the collective op started before the computation
+ *            and waited for after it
+ * In args:   op, d
+ *            use_thread:  1 to run the progress thread meanwhile
+ *            poll_us:     poll interval of the progress thread
+ * Ret val:   The best time over the processes' maximum
+ * Note:      The progress thread is started before the clock and
+ *            stopped after it, so its creation isn't timed.
+ */
+double Time_overlap(
+      op_t     op          /* in     */,
+      data_t*  d           /* in/out */,
+      int      use_thread  /* in     */,
+      int      poll_us     /* in     */) {
+   int t;
+   double start, local_elapsed, elapsed, best = 1.0e30;
+   MPI_Request req;
+   progress_t progress;
+
+   for (t = 0; t < TRIALS; t++) {
+      if (use_thread) Progress_start(&progress, d->comm, poll_us);
+      MPI_Barrier(d->comm);
+      start = MPI_Wtime();
+      Start_op(op, d, &req);
+      Compute(d);
+      MPI_Wait(&req, MPI_STATUS_IGNORE);
+      local_elapsed = MPI_Wtime() - start;
+      if (use_thread) Progress_stop(&progress);
+      MPI_Allreduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX,
+            d->comm);
+      if (elapsed < best) best = elapsed;
+   }
+   return best;
+}  /* Time_overlap */
+
+/*-------------------------------------------------------------------
+ * Function:  Progress_start
+ * Purpose:   Start a progress thread
+ * In args:   comm:     communicator to duplicate for the thread
+ *            poll_us:  microseconds between calls into MPI
+ * Out arg:   p
+ * Note:      Collective over comm (MPI_Comm_dup)
+ */
+void Progress_start(progress_t* p, MPI_Comm comm, int poll_us) {
+   MPI_Comm_dup(comm, &p->comm);
+   p->poll_us = poll_us;
+   atomic_store(&p->stop, 0);
+   pthread_create(&p->thread, NULL, Progress_loop, p);
+}  /* Progress_start */
+
+/*-------------------------------------------------------------------
+ * Function:  Progress_stop
+ * Purpose:   Stop a progress thread and free its communicator
+ * In/out:    p
+ */
+void Progress_stop(progress_t* p) {
+   atomic_store(&p->stop, 1);
+   pthread_join(p->thread, NULL);
+   MPI_Comm_free(&p->comm);
+}  /* Progress_stop */
+
+/*-------------------------------------------------------------------
+ * Function:  Progress_loop
+ * Purpose:   Thread function of the progress thread:  call into MPI
+ *            until told to stop
+ * In/out:    p_p:  the progress_t
+ */
+void* Progress_loop(void* p_p) {
+   progress_t* p = p_p;
+   int flag;
+
+   while (!atomic_load(&p->stop)) {
+      MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, p->comm, &flag,
+            MPI_STATUS_IGNORE);
+      if (p->poll_us > 0)
+         usleep(p->poll_us);
+      else
+         sched_yield();
+   }
+   return NULL;
+}  /* Progress_loop */
@@ -0,0 +1,514 @@
+/* File:     mpi_sparse_vector.c
+ *
+ * Purpose:  Implement sparse vector operations on vectors that use
+ *           the same block distribution as mpi_vector_add.c.  Each
+ *           process stores the nonzeros of its block as a sorted
+ *           list of local indices and a parallel list of values
+ *           (one row of a CSR matrix), so the kernels only touch
+ *           the nonzeros instead of streaming the zeros.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_sparse_vector mpi_sparse_vector.c \
+ *              lab3_kernels.c lab3_kernels_mpi.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_sparse_vector [<n> [<density>]]
+ *
+ * Input:    Optional command line args: the order of the vectors, n
+ *           (default 10000000) and the fraction of nonzeros in the
+ *           sparse vectors (default 0.005)
+ * Output:   Run time of the dense and sparse versions of the sum and
+ *           the dot product, and the maximum difference between the
+ *           sparse and the dense results.
+ *
+ * Notes:
+ * 1.  The order of the vectors, n, should be evenly divisible
+ *     by comm_sz
+ * 2.  Indices are local to the block:  the global index of
+ *     local_s.ind[k] on process q is q*local_n + local_s.ind[k].
+ * 3.  The kernels use separate index and value arrays and several
+ *     independent accumulators so the compiler can vectorize them
+ *     (with gathers when the target supports them).
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+typedef struct {
+   int      nnz;   /* number of stored entries              */
+   int*     ind;   /* local indices, strictly increasing    */
+   double*  val;   /* values, val[k] is entry ind[k]        */
+} sparse_vector_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, double* density_p,
+      int my_rank, int comm_sz, MPI_Comm comm);
+void Allocate_sparse(sparse_vector_t* local_s_p, int max_nnz,
+      MPI_Comm comm);
+void Free_sparse(sparse_vector_t* local_s_p);
+void Generate_sparse(sparse_vector_t* local_s_p, int local_n,
+      double density, MPI_Comm comm);
+void Sparse_to_dense(sparse_vector_t* local_s_p, double local_a[],
+      int local_n);
+void Parallel_sparse_dense_sum(sparse_vector_t* local_s_p,
+      double local_y[], double local_z[], int local_n);
+void Parallel_sparse_dense_sum_inplace(sparse_vector_t* local_s_p,
+      double local_y[]);
+double Parallel_sparse_dot_product(sparse_vector_t* local_s_p,
+      double local_y[], MPI_Comm comm);
+void Parallel_sparse_sum(sparse_vector_t* local_s_p,
+      sparse_vector_t* local_t_p, sparse_vector_t* local_r_p);
+double Max_diff(double local_a[], double local_b[], int local_n,
+      MPI_Comm comm);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, local_n, i;
+   int comm_sz, my_rank;
+   double density;
+   sparse_vector_t local_s, local_t, local_r;
+   double *local_x, *local_y, *local_z, *local_w;
+   double dense_dot, sparse_dot;
+   double start, finish, loc_elapsed, elapsed[6], diff[3];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &density, my_rank, comm_sz, comm);
+   local_n = n/comm_sz;
+
+   local_x = malloc(local_n*sizeof(double));
+   local_y = malloc(local_n*sizeof(double));
+   local_z = malloc(local_n*sizeof(double));
+   local_w = malloc(local_n*sizeof(double));
+   Check_for_error(local_x != NULL && local_y != NULL && local_z != NULL
+         && local_w != NULL, "main", "Can't allocate local vector(s)",
+         comm);
+
+   srand(time(NULL) + my_rank);
+   Generate_sparse(&local_s, local_n, density, comm);
+   Generate_sparse(&local_t, local_n, density, comm);
+   for (i = 0; i < local_n; i++)
+      local_y[i] = (double)(rand() % 100);
+   /* Touch the outputs so the timed sums don't take their page faults */
+   memset(local_z, 0, local_n*sizeof(double));
+   memset(local_w, 0, local_n*sizeof(double));
+
+   /* Dense reference:  z = x + y and x.y with x = densified s */
+   Sparse_to_dense(&local_s, local_x, local_n);
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Parallel_vector_sum(local_x, local_y, local_z, local_n);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   dense_dot = Parallel_dot_product(local_x, local_y, local_n, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   /* Sparse versions */
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Parallel_sparse_dense_sum(&local_s, local_y, local_w, local_n);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[2], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   diff[0] = Max_diff(local_z, local_w, local_n, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   sparse_dot = Parallel_sparse_dot_product(&local_s, local_y, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[3], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   /* y += s only touches the nonzeros of s */
+   memcpy(local_w, local_y, local_n*sizeof(double));
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Parallel_sparse_dense_sum_inplace(&local_s, local_w);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[5], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   diff[1] = Max_diff(local_z, local_w, local_n, comm);
+
+   /* r = s + t, checked against the dense sum of both */
+   Allocate_sparse(&local_r, local_s.nnz + local_t.nnz, comm);
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Parallel_sparse_sum(&local_s, &local_t, &local_r);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[4], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   Sparse_to_dense(&local_t, local_y, local_n);
+   Parallel_vector_sum(local_x, local_y, local_z, local_n);
+   Sparse_to_dense(&local_r, local_w, local_n);
+   diff[2] = Max_diff(local_z, local_w, local_n, comm);
+
+   if (my_rank == 0) {
+      printf("n = %d, density = %g, comm_sz = %d\n", n, density, comm_sz);
+      printf("Dense  sum  z = x + y:    %f ms\n", elapsed[0]*1000);
+      printf("Sparse sum  z = s + y:    %f ms (max diff %e)\n",
+            elapsed[2]*1000, diff[0]);
+      printf("Sparse sum  y += s:       %f ms (max diff %e)\n",
+            elapsed[5]*1000, diff[1]);
+      printf("Dense  dot  x.y:          %f ms = %f\n", elapsed[1]*1000,
+            dense_dot);
+      printf("Sparse dot  s.y:          %f ms = %f (diff %e)\n",
+            elapsed[3]*1000, sparse_dot, fabs(sparse_dot - dense_dot));
+      printf("Sparse sum  r = s + t:    %f ms (max diff %e)\n",
+            elapsed[4]*1000, diff[2]);
+   }
+
+   Free_sparse(&local_s);
+   Free_sparse(&local_t);
+   Free_sparse(&local_r);
+   free(local_x);
+   free(local_y);
+   free(local_z);
+   free(local_w);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors and the density of the
+ *            sparse vectors from the command line
+ * In args:   argc, argv:  command line
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Out args:  n_p:        global order of the vectors
+ *            density_p:  fraction of nonzero entries
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            and 0 < density <= 1
+ */
+void Get_args(
+      int       argc        /* in  */,
+      char*     argv[]      /* in  */,
+      int*      n_p         /* out */,
+      double*   density_p   /* out */,
+      int       my_rank     /* in  */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   int local_ok = 1;
+
+   *n_p = 10000000;
+   *density_p = 0.005;
+   if (argc > 1) *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *density_p = strtod(argv[2], NULL);
+
+   if (*n_p <= 0 || *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*density_p <= 0.0 || *density_p > 1.0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "density should be in (0, 1]", comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Allocate_sparse
+ * Purpose:   Allocate storage for a local sparse vector with room
+ *            for max_nnz entries
+ * In args:   max_nnz:  capacity of the vector
+ *            comm:     communicator containing the calling processes
+ * Out arg:   local_s_p:  the sparse vector, with nnz = 0
+ *
+ * Errors:    One or more of the calls to malloc fails
+ */
+void Allocate_sparse(
+      sparse_vector_t*  local_s_p  /* out */,
+      int               max_nnz    /* in  */,
+      MPI_Comm          comm       /* in  */) {
+   int local_ok = 1;
+
+   /* malloc(0) may return NULL */
+   local_s_p->nnz = 0;
+   local_s_p->ind = malloc((max_nnz + 1)*sizeof(int));
+   local_s_p->val = malloc((max_nnz + 1)*sizeof(double));
+   if (local_s_p->ind == NULL || local_s_p->val == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Allocate_sparse",
+         "Can't allocate local sparse vector", comm);
+}  /* Allocate_sparse */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Free_sparse
+ * Purpose:   Free the storage of a local sparse vector
+ * In/out arg:  local_s_p
+ */
+void Free_sparse(sparse_vector_t* local_s_p  /* in/out */) {
+   free(local_s_p->ind);
+   free(local_s_p->val);
+   local_s_p->ind = NULL;
+   local_s_p->val = NULL;
+   local_s_p->nnz = 0;
+}  /* Free_sparse */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Generate_sparse
+ * Purpose:   Allocate and fill a local sparse vector in which each
+ *            entry is nonzero with probability density
+ * In args:   local_n:  order of the local block
+ *            density:  fraction of nonzeros
+ *            comm:     communicator containing the calling processes
+ * Out arg:   local_s_p:  the sparse vector
+ *
+ * Note:      Storage is sized for the expected number of nonzeros
+ *            plus some slack, and grown if the draw exceeds it.
+ */
+void Generate_sparse(
+      sparse_vector_t*  local_s_p  /* out */,
+      int               local_n    /* in  */,
+      double            density    /* in  */,
+      MPI_Comm          comm       /* in  */) {
+   int local_i, cap;
+   int local_ok = 1;
+   int threshold = (int) (density*RAND_MAX);
+   int* ind;
+   double* val;
+
+   cap = (int) (1.25*density*local_n) + 16;
+   if (cap > local_n) cap = local_n;
+   Allocate_sparse(local_s_p, cap, comm);
+
+   for (local_i = 0; local_i < local_n && local_ok; local_i++) {
+      if (rand() > threshold) continue;
+      if (local_s_p->nnz == cap) {
+         cap = 2*cap < local_n ? 2*cap : local_n;
+         /* On failure the old blocks stay in *local_s_p */
+         ind = realloc(local_s_p->ind, (cap + 1)*sizeof(int));
+         if (ind != NULL) local_s_p->ind = ind;
+         val = realloc(local_s_p->val, (cap + 1)*sizeof(double));
+         if (val != NULL) local_s_p->val = val;
+         if (ind == NULL || val == NULL)
+            local_ok = 0;
+      }
+      if (local_ok) {
+         local_s_p->ind[local_s_p->nnz] = local_i;
+         local_s_p->val[local_s_p->nnz] = (double)(rand() % 99 + 1);
+         local_s_p->nnz++;
+      }
+   }
+   Check_for_error(local_ok, "Generate_sparse",
+         "Can't grow local sparse vector", comm);
+}  /* Generate_sparse */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sparse_to_dense
+ * Purpose:   Expand a local sparse vector into a dense block
+ * In args:   local_s_p:  the sparse vector
+ *            local_n:    order of the local block
+ * Out arg:   local_a:    the dense block
+ */
+void Sparse_to_dense(
+      sparse_vector_t*  local_s_p  /* in  */,
+      double            local_a[]  /* out */,
+      int               local_n    /* in  */) {
+   int k;
+
+   memset(local_a, 0, local_n*sizeof(double));
+   for (k = 0; k < local_s_p->nnz; k++)
+      local_a[local_s_p->ind[k]] = local_s_p->val[k];
+}  /* Sparse_to_dense */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_sparse_dense_sum
+ * Purpose:   Compute z = s + y where s is sparse and y is dense
+ * In args:   local_s_p:  local block of the sparse vector
+ *            local_y:    local block of the dense vector
+ *            local_n:    order of the local blocks
+ * Out arg:   local_z:    local block of the (dense) sum
+ *
+ * Note:      z must not alias y.  Use
+ *            Parallel_sparse_dense_sum_inplace for y += s.
+ */
+void Parallel_sparse_dense_sum(
+      sparse_vector_t*  local_s_p  /* in  */,
+      double            local_y[]  /* in  */,
+      double            local_z[]  /* out */,
+      int               local_n    /* in  */) {
+   memcpy(local_z, local_y, local_n*sizeof(double));
+   Parallel_sparse_dense_sum_inplace(local_s_p, local_z);
+}  /* Parallel_sparse_dense_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_sparse_dense_sum_inplace
+ * Purpose:   Compute y += s where s is sparse and y is dense.  Only
+ *            the nonzeros of s are touched.
+ * In arg:    local_s_p:  local block of the sparse vector
+ * In/out arg:  local_y:  local block of the dense vector
+ */
+void Parallel_sparse_dense_sum_inplace(
+      sparse_vector_t*  local_s_p  /* in     */,
+      double            local_y[]  /* in/out */) {
+   const int* restrict ind = local_s_p->ind;
+   const double* restrict val = local_s_p->val;
+   int k, nnz = local_s_p->nnz;
+
+   /* The indices are distinct, so the scatter has no conflicts */
+   for (k = 0; k < nnz; k++)
+      local_y[ind[k]] += val[k];
+}  /* Parallel_sparse_dense_sum_inplace */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_sparse_dot_product
+ * Purpose:   Compute the dot product of a sparse and a dense vector
+ * In args:   local_s_p:  local block of the sparse vector
+ *            local_y:    local block of the dense vector
+ *            comm:       communicator containing the calling processes
+ * Ret val:   The dot product on process 0, 0 on the other processes
+ */
+double Parallel_sparse_dot_product(
+      sparse_vector_t*  local_s_p  /* in */,
+      double            local_y[]  /* in */,
+      MPI_Comm          comm       /* in */) {
+   const int* restrict ind = local_s_p->ind;
+   const double* restrict val = local_s_p->val;
+   int k, nnz = local_s_p->nnz;
+   double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+   double local_dot, dot = 0.0;
+
+   /* Independent partial sums keep the gathers from serializing */
+   for (k = 0; k + 3 < nnz; k += 4) {
+      s0 += val[k]*local_y[ind[k]];
+      s1 += val[k+1]*local_y[ind[k+1]];
+      s2 += val[k+2]*local_y[ind[k+2]];
+      s3 += val[k+3]*local_y[ind[k+3]];
+   }
+   for (; k < nnz; k++)
+      s0 += val[k]*local_y[ind[k]];
+   local_dot = (s0 + s1) + (s2 + s3);
+
+   MPI_Reduce(&local_dot, &dot, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+   return dot;
+}  /* Parallel_sparse_dot_product */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_sparse_sum
+ * Purpose:   Compute r = s + t where s and t are both sparse by
+ *            merging their sorted index lists
+ * In args:   local_s_p, local_t_p:  local blocks of the summands
+ * Out arg:   local_r_p:  local block of the sum.  Must have room for
+ *            local_s_p->nnz + local_t_p->nnz entries.
+ *
+ * Note:      Entries present in both s and t are kept even if they
+ *            cancel, so the pattern of r is the union of the
+ *            patterns of s and t.
+ */
+void Parallel_sparse_sum(
+      sparse_vector_t*  local_s_p  /* in  */,
+      sparse_vector_t*  local_t_p  /* in  */,
+      sparse_vector_t*  local_r_p  /* out */) {
+   const int* restrict s_ind = local_s_p->ind;
+   const int* restrict t_ind = local_t_p->ind;
+   const double* restrict s_val = local_s_p->val;
+   const double* restrict t_val = local_t_p->val;
+   int* restrict r_ind = local_r_p->ind;
+   double* restrict r_val = local_r_p->val;
+   int i = 0, j = 0, k = 0;
+   int s_nnz = local_s_p->nnz, t_nnz = local_t_p->nnz;
+
+   while (i < s_nnz && j < t_nnz) {
+      if (s_ind[i] < t_ind[j]) {
+         r_ind[k] = s_ind[i];
+         r_val[k++] = s_val[i++];
+      } else if (t_ind[j] < s_ind[i]) {
+         r_ind[k] = t_ind[j];
+         r_val[k++] = t_val[j++];
+      } else {
+         r_ind[k] = s_ind[i];
+         r_val[k++] = s_val[i++] + t_val[j++];
+      }
+   }
+
+   /* At most one of the tails is nonempty:  plain block copies */
+   memcpy(r_ind + k, s_ind + i, (s_nnz - i)*sizeof(int));
+   memcpy(r_val + k, s_val + i, (s_nnz - i)*sizeof(double));
+   k += s_nnz - i;
+   memcpy(r_ind + k, t_ind + j, (t_nnz - j)*sizeof(int));
+   memcpy(r_val + k, t_val + j, (t_nnz - j)*sizeof(double));
+   k += t_nnz - j;
+
+   local_r_p->nnz = k;
+}  /* Parallel_sparse_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Find the largest absolute difference between the
+ *            entries of two distributed vectors
+ * In args:   local_a, local_b:  local blocks of the vectors
+ *            local_n:  order of the local blocks
+ *            comm:     communicator containing the calling processes
+ * Ret val:   max |a[i] - b[i]| on process 0
+ */
+double Max_diff(
+      double    local_a[]  /* in */,
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      MPI_Comm  comm       /* in */) {
+   int local_i;
+   double local_max = 0.0, max = 0.0;
+
+   for (local_i = 0; local_i < local_n; local_i++)
+      if (fabs(local_a[local_i] - local_b[local_i]) > local_max)
+         local_max = fabs(local_a[local_i] - local_b[local_i]);
+   MPI_Reduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   return max;
+}  /* Max_diff */
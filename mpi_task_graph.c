@@ -0,0 +1,706 @@
+/* File:     mpi_task_graph.c
+ *
+ * Purpose:  Run the chain of vector operations of mpi_vector_add3.c
+ *           (print x and y, dot product, scalar multiplication, print
+ *           x and y again) plus z = x + y as a graph of tasks.  Each
+ *           task is submitted with the buffers it reads and writes,
+ *           the runtime derives the dependences from them, and tasks
+ *           whose inputs are ready run concurrently:  compute tasks
+ *           on a pool of worker threads, communication tasks on a
+ *           communication thread, so gathers and reductions overlap
+ *           the local kernels.  The program times the graph against
+ *           running the same tasks one after the other.
+ *
+ * Compile:  mpicc -O3 -Wall -pthread -o mpi_task_graph mpi_task_graph.c \
+ *              lab3_kernels.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_task_graph [-n <n>] [-t <threads>]
+ *                 [-v]
+ *
+ * Input:    None
+ * Output:   For each run, a checksum line for each printed vector, the
+ *           dot product and the elapsed time; with -v, the start and
+ *           finish times of each task on process 0.
+ *
+ * Notes:
+ * 1.  n (default 4000000) should be evenly divisible by comm_sz.
+ *     threads (default 2) is the number of compute workers.
+ * 2.  A task that reads a buffer depends on the last task that wrote
+ *     it; a task that writes a buffer also depends on every task that
+ *     read it since.  So tasks run as if in submission order.
+ * 3.  MPI calls are only made by the communication thread, which runs
+ *     the communication tasks in submission order, so every process
+ *     calls the collectives in the same order.  This needs
+ *     MPI_THREAD_SERIALIZED; if the library doesn't provide it, the
+ *     graph is run sequentially.  So the trace times of the tasks
+ *     come from Now (clock_gettime), not MPI_Wtime, which the compute
+ *     workers can't call while the communication thread is in MPI.
+ * 4.  Printing a vector gathers it to process 0, which prints its
+ *     first elements and the sum of all of them.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+#define MAX_TASKS    32
+#define MAX_BUFFERS  8
+#define MAX_THREADS  64
+#define PRINT_COUNT  5
+
+typedef enum {TASK_COMPUTE, TASK_COMM} task_kind_t;
+
+/* Buffers of the vector operations */
+enum {BUF_X, BUF_Y, BUF_Z, BUF_LOCAL_DOT, BUF_DOT};
+
+typedef struct {
+   char*        name;
+   task_kind_t  kind;
+   void         (*fn)(void* arg);
+   void*        arg;
+   int          pending;              /* unfinished predecessors */
+   int          succ[MAX_TASKS];
+   int          succ_count;
+   double       start, finish;
+} task_t;
+
+typedef struct {
+   task_t           tasks[MAX_TASKS];
+   int              task_count;
+   /* Dependence tracking */
+   int              last_writer[MAX_BUFFERS];
+   int              readers[MAX_BUFFERS][MAX_TASKS];
+   int              reader_count[MAX_BUFFERS];
+   /* Scheduling */
+   int              ready[MAX_TASKS];  /* ready compute tasks (FIFO) */
+   int              ready_head, ready_tail;
+   int              comm_tasks[MAX_TASKS];
+   int              comm_count, comm_next;
+   int              remaining;
+   double           t0;
+   pthread_mutex_t  lock;
+   pthread_cond_t   cond;
+} graph_t;
+
+/* Arguments of the vector operations */
+typedef struct {
+   double*   local_x;
+   double*   local_y;
+   double*   local_z;
+   int       local_n;
+   int       n;
+   double    scalar;
+   double    local_dot;
+   double    dot;
+   int       my_rank;
+   MPI_Comm  comm;
+} vectors_t;
+
+typedef struct {
+   vectors_t*  v;
+   double*     local_b;
+   char*       title;
+} print_arg_t;
+
+typedef struct {
+   vectors_t*  v;
+   double*     local_b;
+} scale_arg_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* threads_p,
+      int* verbose_p, int my_rank, int comm_sz, MPI_Comm comm);
+void Allocate_vectors(double** local_x_pp, double** local_y_pp,
+      double** local_z_pp, int local_n, MPI_Comm comm);
+void Generate_vectors(double local_x[], double local_y[], int local_n,
+      int my_rank);
+void Graph_init(graph_t* g);
+int Graph_submit(graph_t* g, char name[], task_kind_t kind,
+      void (*fn)(void*), void* arg, int reads[], int writes[]);
+void Graph_run(graph_t* g, int threads);
+void Graph_run_sequential(graph_t* g);
+void Graph_destroy(graph_t* g);
+void Graph_print_trace(graph_t* g);
+double Now(void);
+void* Worker(void* g_p);
+void* Comm_worker(void* g_p);
+void Complete_task(graph_t* g, int t);
+void Build_graph(graph_t* g, vectors_t* v, print_arg_t print_args[],
+      scale_arg_t scale_args[]);
+void Print_task(void* arg);
+void Dot_task(void* arg);
+void Reduce_task(void* arg);
+void Sum_task(void* arg);
+void Scale_task(void* arg);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, threads, verbose, provided, run;
+   int comm_sz, my_rank;
+   double local_start, local_elapsed, elapsed[2], dots[2];
+   vectors_t v;
+   print_arg_t print_args[5];
+   scale_arg_t scale_args[2];
+   graph_t g;
+   MPI_Comm comm;
+
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &threads, &verbose, my_rank, comm_sz, comm);
+   if (provided < MPI_THREAD_SERIALIZED) {
+      if (my_rank == 0)
+         fprintf(stderr, "MPI_THREAD_SERIALIZED isn't available, "
+               "running the graph sequentially\n");
+      threads = 0;
+   }
+
+   v.n = n;
+   v.local_n = n/comm_sz;
+   v.scalar = 2.5;
+   v.my_rank = my_rank;
+   v.comm = comm;
+   Allocate_vectors(&v.local_x, &v.local_y, &v.local_z, v.local_n, comm);
+
+   /* Run 0 is sequential, run 1 uses the threads */
+   for (run = 0; run < 2; run++) {
+      if (run == 1 && threads == 0) break;
+      Generate_vectors(v.local_x, v.local_y, v.local_n, my_rank);
+      Graph_init(&g);
+      Build_graph(&g, &v, print_args, scale_args);
+      if (my_rank == 0)
+         printf("%s:\n", run == 0 ? "Sequential" : "Task graph");
+
+      MPI_Barrier(comm);
+      local_start = MPI_Wtime();
+      g.t0 = Now();
+      if (run == 0)
+         Graph_run_sequential(&g);
+      else
+         Graph_run(&g, threads);
+      local_elapsed = MPI_Wtime() - local_start;
+      MPI_Reduce(&local_elapsed, &elapsed[run], 1, MPI_DOUBLE, MPI_MAX, 0,
+            comm);
+      dots[run] = v.dot;
+
+      if (my_rank == 0) {
+         printf("   Dot product = %.15e\n", v.dot);
+         printf("   Elapsed time = %e seconds\n", elapsed[run]);
+         if (verbose) Graph_print_trace(&g);
+      }
+      Graph_destroy(&g);
+   }
+
+   if (my_rank == 0 && threads > 0) {
+      printf("Speedup with %d compute threads = %.2f\n", threads,
+            elapsed[0]/elapsed[1]);
+      if (dots[0] != dots[1])
+         printf("Warning:  the dot products differ\n");
+   }
+
+   free(v.local_x);
+   free(v.local_y);
+   free(v.local_z);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors, the number of compute
+ *            threads and the verbose flag from the command line
+ * In args:   argc, argv, my_rank, comm_sz, comm
+ * Out args:  n_p, threads_p, verbose_p
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            and 0 <= threads <= MAX_THREADS
+ */
+void Get_args(
+      int       argc       /* in  */,
+      char*     argv[]     /* in  */,
+      int*      n_p        /* out */,
+      int*      threads_p  /* out */,
+      int*      verbose_p  /* out */,
+      int       my_rank    /* in  */,
+      int       comm_sz    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   int c, local_ok = 1;
+
+   *n_p = 4000000;
+   *threads_p = 2;
+   *verbose_p = 0;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:t:v")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 't': *threads_p = strtol(optarg, NULL, 10); break;
+         case 'v': *verbose_p = 1; break;
+         default:  local_ok = 0;
+      }
+   Check_for_error(local_ok, "Get_args",
+         "usage: mpi_task_graph [-n <n>] [-t <threads>] [-v]", comm);
+   Check_for_error(*n_p > 0 && *n_p % comm_sz == 0, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   Check_for_error(*threads_p >= 0 && *threads_p <= MAX_THREADS,
+         "Get_args", "threads should be between 0 and 64", comm);
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:  Allocate_vectors
+ * Purpose:   Allocate storage for x, y, and z
+ * In args:   local_n:  the size of the local vectors
+ *            comm:     the communicator containing the calling processes
+ * Out args:  local_x_pp, local_y_pp, local_z_pp:  pointers to memory
+ *               blocks to be allocated for local vectors
+ *
+ * Errors:    One or more of the calls to malloc fails
+ */
+void Allocate_vectors(
+      double**   local_x_pp  /* out */,
+      double**   local_y_pp  /* out */,
+      double**   local_z_pp  /* out */,
+      int        local_n     /* in  */,
+      MPI_Comm   comm        /* in  */) {
+   int local_ok = 1;
+   char* fname = "Allocate_vectors";
+
+   *local_x_pp = malloc(local_n*sizeof(double));
+   *local_y_pp = malloc(local_n*sizeof(double));
+   *local_z_pp = malloc(local_n*sizeof(double));
+
+   if (*local_x_pp == NULL || *local_y_pp == NULL ||
+       *local_z_pp == NULL) local_ok = 0;
+   Check_for_error(local_ok, fname, "Can't allocate local vector(s)",
+         comm);
+}  /* Allocate_vectors */
+
+/*-------------------------------------------------------------------
+ * Function:  Generate_vectors
+ * Purpose:   Fill the local blocks of x and y with the same random
+ *            values in every run
+ * In args:   local_n, my_rank
+ * Out args:  local_x, local_y
+ */
+void Generate_vectors(
+      double  local_x[]  /* out */,
+      double  local_y[]  /* out */,
+      int     local_n    /* in  */,
+      int     my_rank    /* in  */) {
+   int local_i;
+
+   srand(my_rank + 1);
+   for (local_i = 0; local_i < local_n; local_i++) {
+      local_x[local_i] = (double) (rand() % 100);
+      local_y[local_i] = (double) (rand() % 100);
+   }
+}  /* Generate_vectors */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_init
+ * Purpose:   Initialize an empty task graph
+ * Out arg:   g
+ */
+void Graph_init(graph_t* g) {
+   int b;
+
+   memset(g, 0, sizeof(graph_t));
+   for (b = 0; b < MAX_BUFFERS; b++)
+      g->last_writer[b] = -1;
+   pthread_mutex_init(&g->lock, NULL);
+   pthread_cond_init(&g->cond, NULL);
+}  /* Graph_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Add_edge
+ * Purpose:   Make task t wait for task pred (once)
+ */
+static void Add_edge(graph_t* g, int pred, int t) {
+   int i;
+   task_t* p = &g->tasks[pred];
+
+   if (pred < 0 || pred == t) return;
+   for (i = 0; i < p->succ_count; i++)
+      if (p->succ[i] == t) return;
+   p->succ[p->succ_count++] = t;
+   g->tasks[t].pending++;
+}  /* Add_edge */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_submit
+ * Purpose:   Add a task to the graph
+ * In args:   name:    name shown in the trace
+ *            kind:    TASK_COMPUTE or TASK_COMM
+ *            fn, arg: the task runs fn(arg)
+ *            reads:   buffers the task reads, terminated by -1
+ *            writes:  buffers the task writes, terminated by -1
+ * In/out:    g
+ * Ret val:   The number of the task
+ * Note:      The dependences on earlier tasks are found here, so the
+ *            tasks must be submitted in the order a sequential
+ *            program would run them.
+ */
+int Graph_submit(
+      graph_t*     g         /* in/out */,
+      char         name[]    /* in     */,
+      task_kind_t  kind      /* in     */,
+      void         (*fn)(void*),
+      void*        arg       /* in     */,
+      int          reads[]   /* in     */,
+      int          writes[]  /* in     */) {
+   int t = g->task_count++, i, j, b;
+   task_t* task = &g->tasks[t];
+
+   task->name = name;
+   task->kind = kind;
+   task->fn = fn;
+   task->arg = arg;
+
+   for (i = 0; reads[i] >= 0; i++) {
+      b = reads[i];
+      Add_edge(g, g->last_writer[b], t);
+   }
+   for (i = 0; writes[i] >= 0; i++) {
+      b = writes[i];
+      Add_edge(g, g->last_writer[b], t);
+      for (j = 0; j < g->reader_count[b]; j++)
+         Add_edge(g, g->readers[b][j], t);
+   }
+
+   /* Record the accesses after the edges, so a task that reads and
+    * writes a buffer doesn't depend on itself */
+   for (i = 0; reads[i] >= 0; i++) {
+      b = reads[i];
+      g->readers[b][g->reader_count[b]++] = t;
+   }
+   for (i = 0; writes[i] >= 0; i++) {
+      b = writes[i];
+      g->last_writer[b] = t;
+      g->reader_count[b] = 0;
+   }
+
+   if (kind == TASK_COMM)
+      g->comm_tasks[g->comm_count++] = t;
+   g->remaining++;
+   return t;
+}  /* Graph_submit */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_run
+ * Purpose:   Run all the tasks of the graph with threads compute
+ *            workers and a communication thread, and wait for them
+ * In args:   threads
+ * In/out:    g
+ */
+void Graph_run(graph_t* g, int threads) {
+   pthread_t workers[MAX_THREADS], comm_thread;
+   int t;
+
+   for (t = 0; t < g->task_count; t++)
+      if (g->tasks[t].kind == TASK_COMPUTE && g->tasks[t].pending == 0)
+         g->ready[g->ready_tail++] = t;
+
+   pthread_create(&comm_thread, NULL, Comm_worker, g);
+   for (t = 0; t < threads; t++)
+      pthread_create(&workers[t], NULL, Worker, g);
+   for (t = 0; t < threads; t++)
+      pthread_join(workers[t], NULL);
+   pthread_join(comm_thread, NULL);
+}  /* Graph_run */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_run_sequential
+ * Purpose:   Run the tasks one after the other in submission order
+ * In/out:    g
+ */
+void Graph_run_sequential(graph_t* g) {
+   int t;
+
+   for (t = 0; t < g->task_count; t++) {
+      g->tasks[t].start = Now() - g->t0;
+      g->tasks[t].fn(g->tasks[t].arg);
+      g->tasks[t].finish = Now() - g->t0;
+   }
+}  /* Graph_run_sequential */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_destroy
+ * Purpose:   Free the synchronization objects of the graph
+ * In/out:    g
+ */
+void Graph_destroy(graph_t* g) {
+   pthread_mutex_destroy(&g->lock);
+   pthread_cond_destroy(&g->cond);
+}  /* Graph_destroy */
+
+/*-------------------------------------------------------------------
+ * Function:  Graph_print_trace
+ * Purpose:   Print when each task started and finished
+ * In arg:    g
+ */
+void Graph_print_trace(graph_t* g) {
+   int t;
+
+   printf("   %-24s %5s %10s %10s\n", "task", "kind", "start ms",
+         "finish ms");
+   for (t = 0; t < g->task_count; t++)
+      printf("   %-24s %5s %10.3f %10.3f\n", g->tasks[t].name,
+            g->tasks[t].kind == TASK_COMM ? "comm" : "comp",
+            1000*g->tasks[t].start, 1000*g->tasks[t].finish);
+}  /* Graph_print_trace */
+
+/*-------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ * Note:      Any thread can call it, unlike MPI_Wtime
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*-------------------------------------------------------------------
+ * Function:  Worker
+ * Purpose:   Thread function of the compute workers:  run ready
+ *            compute tasks until every task of the graph is done
+ * In arg:    g_p:  the graph
+ */
+void* Worker(void* g_p) {
+   graph_t* g = g_p;
+   int t;
+
+   pthread_mutex_lock(&g->lock);
+   for (;;) {
+      while (g->ready_head == g->ready_tail && g->remaining > 0)
+         pthread_cond_wait(&g->cond, &g->lock);
+      if (g->ready_head == g->ready_tail) break;
+      t = g->ready[g->ready_head++];
+      pthread_mutex_unlock(&g->lock);
+
+      g->tasks[t].start = Now() - g->t0;
+      g->tasks[t].fn(g->tasks[t].arg);
+      g->tasks[t].finish = Now() - g->t0;
+
+      pthread_mutex_lock(&g->lock);
+      Complete_task(g, t);
+   }
+   pthread_mutex_unlock(&g->lock);
+   return NULL;
+}  /* Worker */
+
+/*-------------------------------------------------------------------
+ * Function:  Comm_worker
+ * Purpose:   Thread function of the communication thread:  run the
+ *            communication tasks in submission order, each one as
+ *            soon as its predecessors are done
+ * In arg:    g_p:  the graph
+ */
+void* Comm_worker(void* g_p) {
+   graph_t* g = g_p;
+   int t;
+
+   pthread_mutex_lock(&g->lock);
+   while (g->comm_next < g->comm_count) {
+      t = g->comm_tasks[g->comm_next++];
+      while (g->tasks[t].pending > 0)
+         pthread_cond_wait(&g->cond, &g->lock);
+      pthread_mutex_unlock(&g->lock);
+
+      g->tasks[t].start = Now() - g->t0;
+      g->tasks[t].fn(g->tasks[t].arg);
+      g->tasks[t].finish = Now() - g->t0;
+
+      pthread_mutex_lock(&g->lock);
+      Complete_task(g, t);
+   }
+   pthread_mutex_unlock(&g->lock);
+   return NULL;
+}  /* Comm_worker */
+
+/*-------------------------------------------------------------------
+ * Function:  Complete_task
+ * Purpose:   Release the successors of task t and wake up the
+ *            threads.  The caller holds g->lock.
+ * In arg:    t
+ * In/out:    g
+ */
+void Complete_task(graph_t* g, int t) {
+   int i, s;
+
+   for (i = 0; i < g->tasks[t].succ_count; i++) {
+      s = g->tasks[t].succ[i];
+      if (--g->tasks[s].pending == 0 && g->tasks[s].kind == TASK_COMPUTE)
+         g->ready[g->ready_tail++] = s;
+   }
+   g->remaining--;
+   pthread_cond_broadcast(&g->cond);
+}  /* Complete_task */
+
+/*-------------------------------------------------------------------
+ * Function:  Build_graph
+ * Purpose:   Submit the operations of mpi_vector_add3.c, plus
+ *            z = x + y, in program order
+ * In args:   v:  the vectors
+ * Out args:  print_args, scale_args:  arguments of the tasks
+ * In/out:    g
+ */
+void Build_graph(
+      graph_t*      g             /* in/out */,
+      vectors_t*    v             /* in     */,
+      print_arg_t   print_args[]  /* out    */,
+      scale_arg_t   scale_args[]  /* out    */) {
+   int none[] = {-1};
+
+   print_args[0] = (print_arg_t) {v, v->local_x, "x"};
+   print_args[1] = (print_arg_t) {v, v->local_y, "y"};
+   print_args[2] = (print_arg_t) {v, v->local_z, "z = x + y"};
+   print_args[3] = (print_arg_t) {v, v->local_x, "x*scalar"};
+   print_args[4] = (print_arg_t) {v, v->local_y, "y*scalar"};
+   scale_args[0] = (scale_arg_t) {v, v->local_x};
+   scale_args[1] = (scale_arg_t) {v, v->local_y};
+
+   Graph_submit(g, "print x", TASK_COMM, Print_task, &print_args[0],
+         (int[]) {BUF_X, -1}, none);
+   Graph_submit(g, "print y", TASK_COMM, Print_task, &print_args[1],
+         (int[]) {BUF_Y, -1}, none);
+   Graph_submit(g, "local dot", TASK_COMPUTE, Dot_task, v,
+         (int[]) {BUF_X, BUF_Y, -1}, (int[]) {BUF_LOCAL_DOT, -1});
+   Graph_submit(g, "reduce dot", TASK_COMM, Reduce_task, v,
+         (int[]) {BUF_LOCAL_DOT, -1}, (int[]) {BUF_DOT, -1});
+   Graph_submit(g, "z = x + y", TASK_COMPUTE, Sum_task, v,
+         (int[]) {BUF_X, BUF_Y, -1}, (int[]) {BUF_Z, -1});
+   Graph_submit(g, "print z", TASK_COMM, Print_task, &print_args[2],
+         (int[]) {BUF_Z, -1}, none);
+   Graph_submit(g, "scale x", TASK_COMPUTE, Scale_task, &scale_args[0],
+         (int[]) {BUF_X, -1}, (int[]) {BUF_X, -1});
+   Graph_submit(g, "scale y", TASK_COMPUTE, Scale_task, &scale_args[1],
+         (int[]) {BUF_Y, -1}, (int[]) {BUF_Y, -1});
+   Graph_submit(g, "print x*scalar", TASK_COMM, Print_task,
+         &print_args[3], (int[]) {BUF_X, -1}, none);
+   Graph_submit(g, "print y*scalar", TASK_COMM, Print_task,
+         &print_args[4], (int[]) {BUF_Y, -1}, none);
+}  /* Build_graph */
+
+/*-------------------------------------------------------------------
+ * Function:  Print_task
+ * Purpose:   Gather a distributed vector onto process 0 and print its
+ *            first PRINT_COUNT elements and its sum
+ * In arg:    arg:  a print_arg_t
+ * Errors:    If process 0 can't allocate the vector, it prints a
+ *            message and aborts
+ */
+void Print_task(void* arg) {
+   print_arg_t* p = arg;
+   vectors_t* v = p->v;
+   double* b = NULL;
+   double sum = 0.0;
+   int i;
+
+   if (v->my_rank == 0) {
+      b = malloc(v->n*sizeof(double));
+      if (b == NULL) {
+         fprintf(stderr, "Can't allocate temporary vector\n");
+         MPI_Abort(v->comm, -1);
+      }
+   }
+   MPI_Gather(p->local_b, v->local_n, MPI_DOUBLE, b, v->local_n,
+         MPI_DOUBLE, 0, v->comm);
+   if (v->my_rank == 0) {
+      printf("   %-10s", p->title);
+      for (i = 0; i < PRINT_COUNT && i < v->n; i++)
+         printf(" %.1f", b[i]);
+      for (i = 0; i < v->n; i++)
+         sum += b[i];
+      printf(" ... (suma) %.1f\n", sum);
+      free(b);
+   }
+}  /* Print_task */
+
+/*-------------------------------------------------------------------
+ * Function:  Dot_task
+ * Purpose:   Local part of Parallel_dot_product
+ * In/out:    arg:  the vectors_t; stores local_dot
+ */
+void Dot_task(void* arg) {
+   vectors_t* v = arg;
+
+   v->local_dot = Dot_product(v->local_x, v->local_y, v->local_n);
+}  /* Dot_task */
+
+/*-------------------------------------------------------------------
+ * Function:  Reduce_task
+ * Purpose:   Add the local dot products onto process 0
+ * In/out:    arg:  the vectors_t; stores dot
+ */
+void Reduce_task(void* arg) {
+   vectors_t* v = arg;
+
+   MPI_Reduce(&v->local_dot, &v->dot, 1, MPI_DOUBLE, MPI_SUM, 0, v->comm);
+}  /* Reduce_task */
+
+/*-------------------------------------------------------------------
+ * Function:  Sum_task
+ * Purpose:   Local part of Parallel_vector_sum:  z = x + y
+ * In/out:    arg:  the vectors_t
+ */
+void Sum_task(void* arg) {
+   vectors_t* v = arg;
+
+   Parallel_vector_sum(v->local_x, v->local_y, v->local_z, v->local_n);
+}  /* Sum_task */
+
+/*-------------------------------------------------------------------
+ * Function:  Scale_task
+ * Purpose:   Multiply one local vector by the scalar, the half of
+ *            Parallel_scalar_multiplication for that vector
+ * In/out:    arg:  a scale_arg_t
+ */
+void Scale_task(void* arg) {
+   scale_arg_t* s = arg;
+
+   Vector_scale_in_place(s->local_b, s->v->scalar, s->v->local_n);
+}  /* Scale_task */
@@ -4,11 +4,25 @@
  *           distribution of the vectors.  This version also
  *           illustrates the use of MPI_Scatter and MPI_Gather.
  *
- * Compile:  mpicc -g -Wall -o mpi_vector_add mpi_vector_add.c
- * Run:      mpiexec -n <comm_sz> ./vector_add
+ * Compile:  mpicc -g -Wall [-fopenmp] -o mpi_vector_add mpi_vector_add.c \
+ *              lab3_kernels.c lab3_output.c
+ * Run:      mpiexec -n <comm_sz> ./vector_add [-o <mode>] [-p <pages>]
+ *              [-P <populate>] [-t <thread_count>] [-m <budget MiB>]
+ *              [-i] [-s <scalar>]
  *
  * Input:    The order of the vectors, n, and the vectors x and y
- * Output:   The sum vector z = x+y
+ * Output:   The sum vector z = x+y, shown according to the output
+ *           mode:  none (default), headtail, checksum, hash or
+ *           full.  Only full gathers the vectors to process 0.  The
+ *           hash is the CRC32C of the whole vector, so it can be
+ *           compared across runs with different comm_sz.
+ *           The time of the allocation, population and sum, the
+ *           time of each of those phases, and the page faults and
+ *           dTLB misses over all the processes in that time.
+ *           At the end, the memory report:  the peak bytes of each
+ *           subsystem, the peak of all of them and the peak RSS, each
+ *           as the maximum over the processes, the process with the
+ *           maximum, the average and the imbalance (maximum/average).
  *
  * Notes:
  * 1.  The order of the vectors, n, should be evenly divisible
@@ -19,64 +33,213 @@
  *     quit.  Errors detected are incorrect values of the vector
  *     order (negative or not evenly divisible by comm_sz), and
  *     malloc failures.
+ * 4.  -p selects the pages backing the vectors:  4k (default, malloc),
+ *     thp (2MB aligned and madvise(MADV_HUGEPAGE), used if
+ *     transparent huge pages are enabled), 2m or 1g (explicit huge
+ *     pages, mmap MAP_HUGETLB, which need pages reserved in
+ *     /proc/sys/vm/nr_hugepages or the 1GB pool).  When the pages
+ *     asked for aren't available the allocation falls back to the
+ *     next smaller kind, down to 4k, and the kind actually obtained
+ *     is printed.  Compare the fault and dTLB counts of runs with
+ *     different -p.
+ * 5.  The dTLB misses are read with perf_event_open, and are shown
+ *     as n/a when the kernel doesn't allow it (see
+ *     /proc/sys/kernel/perf_event_paranoid).
+ * 6.  -P populates the pages of the vectors after allocating them, so
+ *     the timed fill and sum don't take the page faults of the first
+ *     writes:  none (default), madvise (madvise(MADV_POPULATE_WRITE),
+ *     which does for an existing block what MAP_POPULATE does in
+ *     mmap, so the allocation and population can be timed apart;
+ *     it falls back to touch on kernels before 5.14) or touch (write
+ *     every page, with thread_count OpenMP threads when compiled with
+ *     -fopenmp; thread_count defaults to 1).  The times of the
+ *     phases are the maximum over the processes.
+ * 7.  Every block the program allocates is accounted to a subsystem:
+ *     the local vectors, the temporaries (the n element vector process
+ *     0 fills in Read_vector) and the comm buffers (the n element
+ *     vector process 0 gathers into in Print_vector).  The asymmetry
+ *     between process 0 and the others shows in the imbalance.
+ * 8.  With -m, the program fails (exit status 1) if the peak of the
+ *     accounted bytes on any process exceeds <budget MiB>, so tests
+ *     can catch memory regressions.  Peak RSS also counts the MPI
+ *     library and isn't checked.
+ * 9.  With -i the sum is computed in place, x += y, and z isn't
+ *     allocated, which saves a third of the vectors' memory and the
+ *     write-allocate traffic of z.  x then holds the sum, so it isn't
+ *     shown as x.  With -s the sum is then scaled in place, z *= scalar.
+ * 10. Parallel_vector_sum (lab3_kernels.c) checks how its arguments
+ *     alias and calls restrict-qualified kernels for distinct blocks and
+ *     for z == x or z == y, so the compiler doesn't have to allow for
+ *     overlap.
  *
  * IPP:  Section 3.4.6 (pp. 109 and ff.)
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include <mpi.h>
+#include "lab3_kernels.h"
+#include "lab3_output.h"
+
+/* How Populate_vectors populates the pages of the vectors */
+typedef enum {POPULATE_NONE, POPULATE_MADVISE, POPULATE_TOUCH}
+      populate_t;
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+/* Stride of the touch loop:  the smallest page */
+#define TOUCH_STRIDE 4096
+
+/* Kinds of pages, from smallest to largest, and their sizes */
+typedef enum {PAGES_4K, PAGES_THP, PAGES_2M, PAGES_1G} page_kind_t;
+#define HUGE_2M (1UL << 21)
+#define HUGE_1G (1UL << 30)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+/* Subsystems that the allocated bytes are accounted to */
+typedef enum {MEM_VECTORS, MEM_TEMPORARY, MEM_COMM, MEM_SUBSYSTEMS}
+      mem_sub_t;
+#define MIB (1024.0*1024.0)
+
+/* Record of a block from Alloc_pages, so Free_pages knows how to
+ * release it and whose bytes they were */
+typedef struct {
+   void*        ptr;
+   size_t       bytes;
+   page_kind_t  kind;
+   mem_sub_t    sub;
+} alloc_t;
+#define MAX_ALLOCS 8
+
+/* Page faults and dTLB misses of the calling process */
+typedef struct {
+   long       minflt;
+   long       majflt;
+   long long  tlb_misses;
+   int        tlb_fd;   /* -1 if perf_event_open isn't available */
+} mem_stats_t;
 
 void Check_for_error(int local_ok, char fname[], char message[],
       MPI_Comm comm);
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], output_mode_t* mode_p,
+      page_kind_t* pages_p, populate_t* populate_p, int* thread_count_p,
+      double* budget_p, int* in_place_p, double* scalar_p, int my_rank,
+      MPI_Comm comm);
 void Read_n(int* n_p, int* local_n_p, int my_rank, int comm_sz,
       MPI_Comm comm);
 void Allocate_vectors(double** local_x_pp, double** local_y_pp,
-      double** local_z_pp, int local_n, MPI_Comm comm);
+      double** local_z_pp, int local_n, page_kind_t pages,
+      page_kind_t* got_p, MPI_Comm comm);
+void Free_vectors(double* local_x, double* local_y, double* local_z);
+void Populate_vectors(double* local_x, double* local_y, double* local_z,
+      int local_n, populate_t populate, int thread_count);
+void Touch_pages(char* block, size_t bytes, int thread_count);
+void* Alloc_pages(size_t bytes, page_kind_t want, mem_sub_t sub,
+      page_kind_t* got_p);
+void Free_pages(void* ptr);
+int Thp_enabled(void);
+int Print_memory(double budget, int my_rank, MPI_Comm comm);
+void Stats_start(mem_stats_t* stats);
+void Stats_stop(mem_stats_t* stats);
+void Print_stats(mem_stats_t* stats, page_kind_t pages, page_kind_t got,
+      int my_rank, MPI_Comm comm);
 void Read_vector(double local_a[], int local_n, int n, char vec_name[],
       int my_rank, MPI_Comm comm);
 void Print_vector(double local_b[], int local_n, int n, char title[],
       int my_rank, MPI_Comm comm);
-void Parallel_vector_sum(double local_x[], double local_y[],
-      double local_z[], int local_n);
 
 
+/* Blocks allocated by Alloc_pages */
+static alloc_t allocs[MAX_ALLOCS];
+static int alloc_count = 0;
+
+/* Bytes of each subsystem now and at their peak, and of all of them */
+static size_t mem_bytes[MEM_SUBSYSTEMS], mem_peak[MEM_SUBSYSTEMS];
+static size_t mem_total = 0, mem_total_peak = 0;
+static char* mem_sub_names[] = {"vectors", "temporaries", "comm buffers"};
+
+static char* page_names[] = {"4k", "thp", "2m", "1g"};
+
 /*-------------------------------------------------------------------*/
-int main(void) {
+int main(int argc, char* argv[]) {
    int n, local_n;
    int comm_sz, my_rank;
    double *local_x, *local_y, *local_z;
+   output_mode_t mode = OUTPUT_NONE;
+   page_kind_t pages = PAGES_4K, got;
+   populate_t populate = POPULATE_NONE;
+   int thread_count = 1, mem_ok, in_place = 0;
+   double budget = 0.0, scalar = 1.0;
+   mem_stats_t stats;
    MPI_Comm comm;
-   double tstart, tend;
+   double tstart, tend, local_t[3], t[3];
 
-   MPI_Init(NULL, NULL);
+   MPI_Init(&argc, &argv);
    comm = MPI_COMM_WORLD;
    MPI_Comm_size(comm, &comm_sz);
    MPI_Comm_rank(comm, &my_rank);
 
+   Get_args(argc, argv, &mode, &pages, &populate, &thread_count, &budget,
+         &in_place, &scalar, my_rank, comm);
+
    //Read_n(&n, &local_n, my_rank, comm_sz, comm);
    n = 10000000;
+   local_n = n/comm_sz;
+   Stats_start(&stats);
    tstart = MPI_Wtime();
-   Allocate_vectors(&local_x, &local_y, &local_z, local_n, comm);
+   Allocate_vectors(&local_x, &local_y, in_place ? NULL : &local_z,
+         local_n, pages, &got, comm);
+   if (in_place) local_z = local_x;
+   local_t[0] = MPI_Wtime();
+   Populate_vectors(local_x, local_y, in_place ? NULL : local_z, local_n,
+         populate, thread_count);
+   local_t[1] = MPI_Wtime();
 
    Read_vector(local_x, local_n, n, "x", my_rank, comm);
-   //Print_vector(local_x, local_n, n, "x is", my_rank, comm);
    Read_vector(local_y, local_n, n, "y", my_rank, comm);
-   //Print_vector(local_y, local_n, n, "y is", my_rank, comm);
 
    Parallel_vector_sum(local_x, local_y, local_z, local_n);
+   if (scalar != 1.0) Vector_scale_in_place(local_z, scalar, local_n);
    tend = MPI_Wtime();
+   Stats_stop(&stats);
+   local_t[2] = tend - local_t[1];
+   local_t[1] -= local_t[0];
+   local_t[0] -= tstart;
+   MPI_Reduce(local_t, t, 3, MPI_DOUBLE, MPI_MAX, 0, comm);
 
-   //Print_vector(local_z, local_n, n, "The sum is", my_rank, comm);
-   if(my_rank==0)
+   if(my_rank==0) {
     printf("\nTook %f ms to run\n", (tend-tstart)*1000);
+    printf("Allocate %f ms, populate %f ms, fill and sum %f ms\n",
+          1000*t[0], 1000*t[1], 1000*t[2]);
+   }
+   Print_stats(&stats, pages, got, my_rank, comm);
+
+   /* Output is outside the timed region */
+   if (!in_place)
+      Output_vector(local_x, local_n, n, "x is", mode,
+            Print_vector, my_rank, comm);
+   Output_vector(local_y, local_n, n, "y is", mode,
+         Print_vector, my_rank, comm);
+   Output_vector(local_z, local_n, n, "The sum is", mode,
+         Print_vector, my_rank, comm);
 
-   free(local_x);
-   free(local_y);
-   free(local_z);
+   Free_vectors(local_x, local_y, in_place ? NULL : local_z);
+   mem_ok = Print_memory(budget, my_rank, comm);
 
    MPI_Finalize();
 
-   return 0;
+   return mem_ok ? 0 : 1;
 }  /* main */
 
 /*-------------------------------------------------------------------
@@ -117,6 +280,103 @@ void Check_for_error(
 }  /* Check_for_error */
 
 
+/*-------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing how to run the program and the
+ *            output modes
+ * In arg:    prog_name:  name of the program
+ */
+void Usage(char prog_name[] /* in */) {
+   fprintf(stderr, "usage: mpiexec -n <comm_sz> %s [-o <mode>] "
+         "[-p <pages>] [-P <populate>] [-t <thread_count>] "
+         "[-m <budget MiB>] [-i] [-s <scalar>]\n", prog_name);
+   Output_modes_usage();
+   fprintf(stderr, "   pages: 4k        malloc\n");
+   fprintf(stderr, "          thp       transparent huge pages\n");
+   fprintf(stderr, "          2m, 1g    explicit huge pages\n");
+   fprintf(stderr, "   populate: none, madvise or touch\n");
+   fprintf(stderr, "   -i: x += y in place, -s: z *= scalar\n");
+}  /* Usage */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the output mode, the kind of pages, how to populate
+ *            them, the threads to do it, the memory budget, whether
+ *            to add in place and the scalar from the command line
+ * In args:   argc, argv:  command line
+ *            my_rank:     process rank in comm
+ *            comm:        communicator containing the calling processes
+ * In/out arg:  mode_p:    on input the default output mode, on output
+ *                         the mode selected with -o, if any
+ *             pages_p:    on input the default kind of pages, on
+ *                         output the kind selected with -p, if any
+ *             populate_p, thread_count_p, budget_p, in_place_p,
+ *                         scalar_p:  likewise, with -P, -t, -m, -i
+ *                         and -s
+ *
+ * Errors:    If an option or mode isn't recognized, or thread_count
+ *            or the budget isn't positive, process 0 prints
+ *            a usage message and all the processes quit.
+ */
+void Get_args(
+      int             argc            /* in     */,
+      char*           argv[]          /* in     */,
+      output_mode_t*  mode_p          /* in/out */,
+      page_kind_t*    pages_p         /* in/out */,
+      populate_t*     populate_p      /* in/out */,
+      int*            thread_count_p  /* in/out */,
+      double*         budget_p        /* in/out */,
+      int*            in_place_p      /* in/out */,
+      double*         scalar_p        /* in/out */,
+      int             my_rank         /* in     */,
+      MPI_Comm        comm            /* in     */) {
+   int c, local_ok = 1;
+
+   opterr = 0;
+   while ((c = getopt(argc, argv, "o:p:P:t:m:is:")) != -1)
+      switch (c) {
+         case 'o':
+            if (!Get_output_mode(optarg, mode_p)) local_ok = 0;
+            break;
+         case 'p':
+            if (strcmp(optarg, "4k") == 0) *pages_p = PAGES_4K;
+            else if (strcmp(optarg, "thp") == 0) *pages_p = PAGES_THP;
+            else if (strcmp(optarg, "2m") == 0) *pages_p = PAGES_2M;
+            else if (strcmp(optarg, "1g") == 0) *pages_p = PAGES_1G;
+            else local_ok = 0;
+            break;
+         case 'P':
+            if (strcmp(optarg, "none") == 0) *populate_p = POPULATE_NONE;
+            else if (strcmp(optarg, "madvise") == 0)
+               *populate_p = POPULATE_MADVISE;
+            else if (strcmp(optarg, "touch") == 0)
+               *populate_p = POPULATE_TOUCH;
+            else local_ok = 0;
+            break;
+         case 't':
+            *thread_count_p = strtol(optarg, NULL, 10);
+            if (*thread_count_p < 1) local_ok = 0;
+            break;
+         case 'm':
+            *budget_p = strtod(optarg, NULL);
+            if (*budget_p <= 0.0) local_ok = 0;
+            break;
+         case 'i':
+            *in_place_p = 1;
+            break;
+         case 's':
+            *scalar_p = strtod(optarg, NULL);
+            break;
+         default:
+            local_ok = 0;
+      }
+
+   if (!local_ok && my_rank == 0) Usage(argv[0]);
+   Check_for_error(local_ok, "Get_args", "bad command line", comm);
+}  /* Get_args */
+
+
 /*-------------------------------------------------------------------
  * Function:  Read_n
  * Purpose:   Get the order of the vectors from stdin on proc 0 and
@@ -155,32 +415,397 @@ void Read_n(
  * Function:  Allocate_vectors
  * Purpose:   Allocate storage for x, y, and z
  * In args:   local_n:  the size of the local vectors
+ *            pages:    the kind of pages to ask for
  *            comm:     the communicator containing the calling processes
  * Out args:  local_x_pp, local_y_pp, local_z_pp:  pointers to memory
- *               blocks to be allocated for local vectors
+ *               blocks to be allocated for local vectors.  local_z_pp
+ *               can be NULL, and then z isn't allocated.
+ *            got_p:    the smallest kind of pages obtained
  *
- * Errors:    One or more of the calls to malloc fails
+ * Errors:    One or more of the allocations fails
  */
 void Allocate_vectors(
-      double**   local_x_pp  /* out */,
-      double**   local_y_pp  /* out */,
-      double**   local_z_pp  /* out */,
-      int        local_n     /* in  */,
-      MPI_Comm   comm        /* in  */) {
+      double**      local_x_pp  /* out */,
+      double**      local_y_pp  /* out */,
+      double**      local_z_pp  /* out */,
+      int           local_n     /* in  */,
+      page_kind_t   pages       /* in  */,
+      page_kind_t*  got_p       /* out */,
+      MPI_Comm      comm        /* in  */) {
    int local_ok = 1;
    char* fname = "Allocate_vectors";
+   size_t bytes = local_n*sizeof(double);
+   page_kind_t got;
 
-   *local_x_pp = malloc(local_n*sizeof(double));
-   *local_y_pp = malloc(local_n*sizeof(double));
-   *local_z_pp = malloc(local_n*sizeof(double));
+   *got_p = pages;
+   *local_x_pp = Alloc_pages(bytes, pages, MEM_VECTORS, &got);
+   if (got < *got_p) *got_p = got;
+   *local_y_pp = Alloc_pages(bytes, pages, MEM_VECTORS, &got);
+   if (got < *got_p) *got_p = got;
+   if (local_z_pp != NULL) {
+      *local_z_pp = Alloc_pages(bytes, pages, MEM_VECTORS, &got);
+      if (got < *got_p) *got_p = got;
+      if (*local_z_pp == NULL) local_ok = 0;
+   }
 
-   if (*local_x_pp == NULL || *local_y_pp == NULL ||
-       *local_z_pp == NULL) local_ok = 0;
+   if (*local_x_pp == NULL || *local_y_pp == NULL) local_ok = 0;
    Check_for_error(local_ok, fname, "Can't allocate local vector(s)",
          comm);
 }  /* Allocate_vectors */
 
 
+/*-------------------------------------------------------------------
+ * Function:  Free_vectors
+ * Purpose:   Free the storage allocated by Allocate_vectors
+ * In args:   local_x, local_y, local_z (NULL if it wasn't allocated)
+ */
+void Free_vectors(
+      double*  local_x  /* in */,
+      double*  local_y  /* in */,
+      double*  local_z  /* in */) {
+   Free_pages(local_x);
+   Free_pages(local_y);
+   Free_pages(local_z);
+}  /* Free_vectors */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Populate_vectors
+ * Purpose:   Fault in the pages of the vectors before they're used
+ * In args:   local_n:       the size of the local vectors
+ *            populate:      how to populate them
+ *            thread_count:  threads for POPULATE_TOUCH
+ * In/out:    local_x, local_y, local_z:  the vectors, NULL if not
+ *               allocated
+ */
+void Populate_vectors(
+      double*     local_x       /* in/out */,
+      double*     local_y       /* in/out */,
+      double*     local_z       /* in/out */,
+      int         local_n       /* in     */,
+      populate_t  populate      /* in     */,
+      int         thread_count  /* in     */) {
+   double* vectors[3] = {local_x, local_y, local_z};
+   size_t bytes = local_n*sizeof(double);
+   long page = sysconf(_SC_PAGESIZE);
+   int v;
+
+   if (populate == POPULATE_NONE) return;
+   for (v = 0; v < 3; v++) {
+      /* madvise needs a page aligned start:  the partial first page
+       * is touched instead */
+      char* start = (char*) vectors[v];
+      char* aligned = (char*) (((uintptr_t) start + page - 1)/page*page);
+      if (start == NULL) continue;
+      if (populate == POPULATE_MADVISE && aligned < start + bytes &&
+            madvise(aligned, start + bytes - aligned,
+               MADV_POPULATE_WRITE) == 0)
+         Touch_pages(start, aligned - start, 1);
+      else
+         Touch_pages(start, bytes, thread_count);
+   }
+}  /* Populate_vectors */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Touch_pages
+ * Purpose:   Write a zero in every page of a block
+ * In args:   bytes:         size of the block
+ *            thread_count:  OpenMP threads to use
+ * In/out:    block
+ */
+void Touch_pages(
+      char*   block         /* in/out */,
+      size_t  bytes         /* in     */,
+      int     thread_count  /* in     */) {
+   long i;
+
+#  pragma omp parallel for num_threads(thread_count) schedule(static)
+   for (i = 0; i < (long) bytes; i += TOUCH_STRIDE)
+      block[i] = 0;
+}  /* Touch_pages */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Alloc_pages
+ * Purpose:   Allocate a block backed by the kind of pages asked for,
+ *            or by the largest smaller kind available, and account its
+ *            bytes to a subsystem
+ * In args:   bytes:  size of the block
+ *            want:   the kind of pages to try first
+ *            sub:    the subsystem the block belongs to
+ * Out arg:   got_p:  the kind of pages obtained
+ * Ret val:   The block, or NULL if even malloc fails
+ *
+ * Note:      2m and 1g blocks are rounded up to a whole number of huge
+ *            pages.  thp blocks are 2MB aligned so the kernel can back
+ *            them with huge pages; they count as 4k when transparent
+ *            huge pages are disabled (Thp_enabled) or madvise fails.
+ */
+void* Alloc_pages(
+      size_t        bytes  /* in  */,
+      page_kind_t   want   /* in  */,
+      mem_sub_t     sub    /* in  */,
+      page_kind_t*  got_p  /* out */) {
+   void* ptr = NULL;
+   page_kind_t kind = want;
+   size_t len = bytes;
+
+   *got_p = PAGES_4K;
+   if (alloc_count == MAX_ALLOCS) return NULL;
+#  ifdef MAP_HUGETLB
+   for (; kind >= PAGES_2M; kind--) {
+      int log_page = kind == PAGES_1G ? 30 : 21;
+      size_t page = 1UL << log_page;
+      len = (bytes + page - 1)/page*page;
+      ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+            (log_page << MAP_HUGE_SHIFT), -1, 0);
+      if (ptr != MAP_FAILED) break;
+      ptr = NULL;
+   }
+#  else
+   if (kind > PAGES_THP) kind = PAGES_THP;
+#  endif
+   if (ptr == NULL && kind == PAGES_THP) {
+      len = (bytes + HUGE_2M - 1)/HUGE_2M*HUGE_2M;
+      ptr = aligned_alloc(HUGE_2M, len);
+      if (ptr != NULL && (!Thp_enabled() ||
+               madvise(ptr, len, MADV_HUGEPAGE) != 0))
+         kind = PAGES_4K;
+   }
+   if (ptr == NULL) {
+      kind = PAGES_4K;
+      len = bytes;
+      ptr = malloc(bytes);
+      if (ptr == NULL) return NULL;
+   }
+
+   allocs[alloc_count].ptr = ptr;
+   allocs[alloc_count].bytes = len;
+   allocs[alloc_count].kind = kind;
+   allocs[alloc_count].sub = sub;
+   alloc_count++;
+   mem_bytes[sub] += len;
+   if (mem_bytes[sub] > mem_peak[sub]) mem_peak[sub] = mem_bytes[sub];
+   mem_total += len;
+   if (mem_total > mem_total_peak) mem_total_peak = mem_total;
+   *got_p = kind;
+   return ptr;
+}  /* Alloc_pages */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Free_pages
+ * Purpose:   Free a block allocated by Alloc_pages
+ * In arg:    ptr:  the block, or NULL
+ */
+void Free_pages(void* ptr /* in */) {
+   int i;
+
+   if (ptr == NULL) return;
+   for (i = 0; i < alloc_count; i++)
+      if (allocs[i].ptr == ptr) {
+         if (allocs[i].kind >= PAGES_2M)
+            munmap(ptr, allocs[i].bytes);
+         else
+            free(ptr);
+         mem_bytes[allocs[i].sub] -= allocs[i].bytes;
+         mem_total -= allocs[i].bytes;
+         allocs[i] = allocs[--alloc_count];
+         return;
+      }
+}  /* Free_pages */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Thp_enabled
+ * Purpose:   Check whether the kernel backs madvise(MADV_HUGEPAGE)
+ *            blocks with transparent huge pages
+ * Ret val:   1 if /sys/kernel/mm/transparent_hugepage/enabled selects
+ *            always or madvise, 0 if it selects never or can't be read
+ *
+ * Note:      madvise(MADV_HUGEPAGE) succeeds even when the setting is
+ *            never, so its return value doesn't tell.
+ */
+int Thp_enabled(void) {
+   FILE* fp;
+   char line[128];
+   int enabled = 0;
+
+   fp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+   if (fp == NULL) return 0;
+   if (fgets(line, sizeof(line), fp) != NULL)
+      enabled = strstr(line, "[always]") != NULL ||
+            strstr(line, "[madvise]") != NULL;
+   fclose(fp);
+   return enabled;
+}  /* Thp_enabled */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Stats_start
+ * Purpose:   Record the page faults so far and start counting dTLB
+ *            misses
+ * Out arg:   stats
+ *
+ * Note:      The dTLB counter is inherited by the threads created
+ *            after this call, so it includes the OpenMP threads that
+ *            touch the pages.  getrusage already counts every thread's
+ *            faults.
+ */
+void Stats_start(mem_stats_t* stats /* out */) {
+   struct rusage usage;
+   struct perf_event_attr attr;
+
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HW_CACHE;
+   attr.config = PERF_COUNT_HW_CACHE_DTLB |
+         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+   attr.disabled = 1;
+   attr.inherit = 1;   /* count the OpenMP threads of Touch_pages */
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   stats->tlb_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+   stats->tlb_misses = -1;
+   if (stats->tlb_fd >= 0) {
+      ioctl(stats->tlb_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(stats->tlb_fd, PERF_EVENT_IOC_ENABLE, 0);
+   }
+
+   getrusage(RUSAGE_SELF, &usage);
+   stats->minflt = usage.ru_minflt;
+   stats->majflt = usage.ru_majflt;
+}  /* Stats_start */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Stats_stop
+ * Purpose:   Find the page faults and dTLB misses since Stats_start
+ * In/out:    stats
+ */
+void Stats_stop(mem_stats_t* stats /* in/out */) {
+   struct rusage usage;
+
+   getrusage(RUSAGE_SELF, &usage);
+   stats->minflt = usage.ru_minflt - stats->minflt;
+   stats->majflt = usage.ru_majflt - stats->majflt;
+   if (stats->tlb_fd >= 0) {
+      ioctl(stats->tlb_fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(stats->tlb_fd, &stats->tlb_misses,
+               sizeof(stats->tlb_misses)) != sizeof(stats->tlb_misses))
+         stats->tlb_misses = -1;
+      close(stats->tlb_fd);
+   }
+}  /* Stats_stop */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_stats
+ * Purpose:   Print on process 0 the kind of pages obtained and the
+ *            page faults and dTLB misses summed over the processes
+ * In args:   stats:    counts of the calling process
+ *            pages:    the kind of pages asked for
+ *            got:      the kind of pages obtained
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ *
+ * Note:      The dTLB misses are n/a if any process couldn't count
+ *            them
+ */
+void Print_stats(
+      mem_stats_t*  stats    /* in */,
+      page_kind_t   pages    /* in */,
+      page_kind_t   got      /* in */,
+      int           my_rank  /* in */,
+      MPI_Comm      comm     /* in */) {
+   long local_flt[2], flt[2];
+   long long tlb, min_tlb;
+   int local_got = got, min_got;
+
+   local_flt[0] = stats->minflt;
+   local_flt[1] = stats->majflt;
+   MPI_Reduce(local_flt, flt, 2, MPI_LONG, MPI_SUM, 0, comm);
+   MPI_Reduce(&stats->tlb_misses, &tlb, 1, MPI_LONG_LONG, MPI_SUM, 0,
+         comm);
+   MPI_Reduce(&stats->tlb_misses, &min_tlb, 1, MPI_LONG_LONG, MPI_MIN, 0,
+         comm);
+   MPI_Reduce(&local_got, &min_got, 1, MPI_INT, MPI_MIN, 0, comm);
+
+   if (my_rank == 0) {
+      printf("Pages: asked for %s, got %s\n", page_names[pages],
+            page_names[min_got]);
+      printf("Page faults: %ld minor, %ld major\n", flt[0], flt[1]);
+      if (min_tlb < 0)
+         printf("dTLB misses: n/a\n");
+      else
+         printf("dTLB misses: %lld\n", tlb);
+   }
+}  /* Print_stats */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Print_memory
+ * Purpose:   Print on process 0 the peak memory of each subsystem, of
+ *            all of them and the peak RSS:  maximum over the processes
+ *            and where it is, average and imbalance, and check the
+ *            peak of all the subsystems against the budget
+ * In args:   budget:   MiB allowed on each process, or 0 for no budget
+ *            my_rank:  process rank in comm
+ *            comm:     communicator containing the calling processes
+ * Ret val:   0 on process 0 if the budget is exceeded, 1 otherwise
+ */
+int Print_memory(
+      double    budget   /* in */,
+      int       my_rank  /* in */,
+      MPI_Comm  comm     /* in */) {
+   struct {double mib; int rank;} local_max[MEM_SUBSYSTEMS + 2],
+         max[MEM_SUBSYSTEMS + 2];
+   double local_mib[MEM_SUBSYSTEMS + 2], sum[MEM_SUBSYSTEMS + 2], avg;
+   char* names[MEM_SUBSYSTEMS + 2];
+   struct rusage usage;
+   int s, comm_sz, ok = 1;
+
+   MPI_Comm_size(comm, &comm_sz);
+   getrusage(RUSAGE_SELF, &usage);
+   for (s = 0; s < MEM_SUBSYSTEMS; s++) {
+      local_mib[s] = mem_peak[s]/MIB;
+      names[s] = mem_sub_names[s];
+   }
+   local_mib[MEM_SUBSYSTEMS] = mem_total_peak/MIB;
+   names[MEM_SUBSYSTEMS] = "all (peak)";
+   /* ru_maxrss is in KiB */
+   local_mib[MEM_SUBSYSTEMS + 1] = usage.ru_maxrss/1024.0;
+   names[MEM_SUBSYSTEMS + 1] = "peak RSS";
+   for (s = 0; s < MEM_SUBSYSTEMS + 2; s++) {
+      local_max[s].mib = local_mib[s];
+      local_max[s].rank = my_rank;
+   }
+   MPI_Reduce(local_max, max, MEM_SUBSYSTEMS + 2, MPI_DOUBLE_INT,
+         MPI_MAXLOC, 0, comm);
+   MPI_Reduce(local_mib, sum, MEM_SUBSYSTEMS + 2, MPI_DOUBLE, MPI_SUM, 0,
+         comm);
+
+   if (my_rank == 0) {
+      printf("Memory (MiB)   %10s %5s %10s %9s\n", "max", "rank", "avg",
+            "imbalance");
+      for (s = 0; s < MEM_SUBSYSTEMS + 2; s++) {
+         avg = sum[s]/comm_sz;
+         printf("%-14s %10.1f %5d %10.1f %9.2f\n", names[s], max[s].mib,
+               max[s].rank, avg, avg > 0.0 ? max[s].mib/avg : 1.0);
+      }
+      if (budget > 0.0 && max[MEM_SUBSYSTEMS].mib > budget) {
+         printf("Memory budget of %.1f MiB exceeded by process %d\n",
+               budget, max[MEM_SUBSYSTEMS].rank);
+         ok = 0;
+      }
+   }
+   return ok;
+}  /* Print_memory */
+
+
 /*-------------------------------------------------------------------
  * Function:   Read_vector
  * Purpose:    Read a vector from stdin on process 0 and distribute
@@ -192,7 +817,7 @@ void Allocate_vectors(
  *             comm:     communicator containing calling processes
  * Out arg:    local_a:  local vector read
  *
- * Errors:     if the malloc on process 0 for temporary storage
+ * Errors:     if the allocation on process 0 of temporary storage
  *             fails the program terminates
  *
  * Note:
@@ -211,9 +836,10 @@ void Read_vector(
    int i;
    int local_ok = 1;
    char* fname = "Read_vector";
+   page_kind_t got;
 
    if (my_rank == 0) {
-      a = malloc(n*sizeof(double));
+      a = Alloc_pages(n*sizeof(double), PAGES_4K, MEM_TEMPORARY, &got);
       if (a == NULL) local_ok = 0;
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
@@ -223,7 +849,7 @@ void Read_vector(
          a[i] = i;
       MPI_Scatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE, 0,
          comm);
-      free(a);
+      Free_pages(a);
    } else {
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
@@ -262,9 +888,10 @@ void Print_vector(
    int i;
    int local_ok = 1;
    char* fname = "Print_vector";
+   page_kind_t got;
 
    if (my_rank == 0) {
-      b = malloc(n*sizeof(double));
+      b = Alloc_pages(n*sizeof(double), PAGES_4K, MEM_COMM, &got);
       if (b == NULL) local_ok = 0;
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
@@ -274,7 +901,7 @@ void Print_vector(
       for (i = 0; i < n; i++)
          printf("%f ", b[i]);
       printf("\n");
-      free(b);
+      Free_pages(b);
    } else {
       Check_for_error(local_ok, fname, "Can't allocate temporary vector",
             comm);
@@ -282,24 +909,3 @@ void Print_vector(
          comm);
    }
 }  /* Print_vector */
-
-
-/*-------------------------------------------------------------------
- * Function:  Parallel_vector_sum
- * Purpose:   Add a vector that's been distributed among the processes
- * In args:   local_x:  local storage of one of the vectors being added
- *            local_y:  local storage for the second vector being added
- *            local_n:  the number of components in local_x, local_y,
- *                      and local_z
- * Out arg:   local_z:  local storage for the sum of the two vectors
- */
-void Parallel_vector_sum(
-      double  local_x[]  /* in  */,
-      double  local_y[]  /* in  */,
-      double  local_z[]  /* out */,
-      int     local_n    /* in  */) {
-   int local_i;
-
-   for (local_i = 0; local_i < local_n; local_i++)
-      local_z[local_i] = local_x[local_i] + local_y[local_i];
-}  /* Parallel_vector_sum */
@@ -4,11 +4,14 @@
  *           distribution of the vectors.  This version also
  *           illustrates the use of MPI_Scatter and MPI_Gather.
  *
- * Compile:  mpicc -g -Wall -o mpi_vector_add mpi_vector_add.c
- * Run:      mpiexec -n <comm_sz> ./vector_add
+ * Compile:  mpicc -g -Wall -o mpi_vector_add2 mpi_vector_add2.c \
+ *              lab3_kernels.c lab3_output.c
+ * Run:      mpiexec -n <comm_sz> ./vector_add [-o <mode>]
  *
  * Input:    The order of the vectors, n, and the vectors x and y
- * Output:   The sum vector z = x+y
+ * Output:   The sum vector z = x+y, shown according to the output
+ *           mode:  none, headtail (default), checksum, hash or
+ *           full.  Only full gathers the vectors to process 0.
  *
  * Notes:
  * 1.  The order of the vectors, n, should be evenly divisible
@@ -24,10 +27,18 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <mpi.h>
+#include "lab3_kernels.h"
+#include "lab3_output.h"
 
 void Check_for_error(int local_ok, char fname[], char message[],
       MPI_Comm comm);
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], output_mode_t* mode_p, int my_rank,
+      MPI_Comm comm);
 void Read_n(int* n_p, int* local_n_p, int my_rank, int comm_sz,
       MPI_Comm comm);
 void Allocate_vectors(double** local_x_pp, double** local_y_pp,
@@ -36,24 +47,25 @@ void Read_vector(double local_a[], int local_n, int n, char vec_name[],
       int my_rank, MPI_Comm comm);
 void Print_vector(double local_b[], int local_n, int n, char title[],
       int my_rank, MPI_Comm comm);
-void Parallel_vector_sum(double local_x[], double local_y[],
-      double local_z[], int local_n);
 
 
 /*-------------------------------------------------------------------*/
-int main(void) {
+int main(int argc, char* argv[]) {
    int n = 100000;
    int local_n;
    int comm_sz, my_rank;
    double *local_x, *local_y, *local_z;
+   output_mode_t mode = OUTPUT_HEAD_TAIL;
    MPI_Comm comm;
    double tstart, tend;
 
-   MPI_Init(NULL, NULL);
+   MPI_Init(&argc, &argv);
    comm = MPI_COMM_WORLD;
    MPI_Comm_size(comm, &comm_sz);
    MPI_Comm_rank(comm, &my_rank);
 
+   Get_args(argc, argv, &mode, my_rank, comm);
+
    local_n = n / comm_sz;
 
    //Read_n(&n, &local_n, my_rank, comm_sz, comm);
@@ -77,9 +89,12 @@ int main(void) {
       printf("Tiempo total: %f milisegundos\n", (tend - tstart) * 1000);
    }
 
-   Print_vector(local_x, local_n, n, "Vector x", my_rank, comm);
-   Print_vector(local_y, local_n, n, "Vector y", my_rank, comm);
-   Print_vector(local_z, local_n, n, "Vector z", my_rank, comm);
+   Output_vector(local_x, local_n, n, "Vector x", mode,
+         Print_vector, my_rank, comm);
+   Output_vector(local_y, local_n, n, "Vector y", mode,
+         Print_vector, my_rank, comm);
+   Output_vector(local_z, local_n, n, "Vector z", mode,
+         Print_vector, my_rank, comm);
 
    free(local_x);
    free(local_y);
@@ -127,6 +142,54 @@ void Check_for_error(
 }  /* Check_for_error */
 
 
+/*-------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing how to run the program and the
+ *            output modes
+ * In arg:    prog_name:  name of the program
+ */
+void Usage(char prog_name[] /* in */) {
+   fprintf(stderr, "usage: mpiexec -n <comm_sz> %s [-o <mode>]\n",
+         prog_name);
+   Output_modes_usage();
+}  /* Usage */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the output mode from the command line
+ * In args:   argc, argv:  command line
+ *            my_rank:     process rank in comm
+ *            comm:        communicator containing the calling processes
+ * In/out arg:  mode_p:    on input the default output mode, on output
+ *                         the mode selected with -o, if any
+ *
+ * Errors:    If an option or mode isn't recognized, process 0 prints
+ *            a usage message and all the processes quit.
+ */
+void Get_args(
+      int             argc     /* in     */,
+      char*           argv[]   /* in     */,
+      output_mode_t*  mode_p   /* in/out */,
+      int             my_rank  /* in     */,
+      MPI_Comm        comm     /* in     */) {
+   int c, local_ok = 1;
+
+   opterr = 0;
+   while ((c = getopt(argc, argv, "o:")) != -1)
+      switch (c) {
+         case 'o':
+            if (!Get_output_mode(optarg, mode_p)) local_ok = 0;
+            break;
+         default:
+            local_ok = 0;
+      }
+
+   if (!local_ok && my_rank == 0) Usage(argv[0]);
+   Check_for_error(local_ok, "Get_args", "bad command line", comm);
+}  /* Get_args */
+
+
 /*-------------------------------------------------------------------
  * Function:  Read_n
  * Purpose:   Get the order of the vectors from stdin on proc 0 and
@@ -272,43 +335,23 @@ void Print_vector(
    int i;
    int local_ok = 1;
    char* fname = "Print_vector";
-   
-   if (my_rank == 0) {
-      b = malloc(n * sizeof(double));
-   }
-   MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0, comm);
+
    if (my_rank == 0) {
-      printf("%s (primeros 10):\n", title);
-      for (int i = 0; i < 10; i++) {
-         printf("%f ", b[i]);
-      }
-      printf("\n");
-      printf("%s (últimos 10):\n", title);
-      for (int i = n - 10; i < n; i++) {
+      b = malloc(n*sizeof(double));
+      if (b == NULL) local_ok = 0;
+      Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+            comm);
+      MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE,
+            0, comm);
+      printf("%s\n", title);
+      for (i = 0; i < n; i++)
          printf("%f ", b[i]);
-      }
       printf("\n");
       free(b);
+   } else {
+      Check_for_error(local_ok, fname, "Can't allocate temporary vector",
+            comm);
+      MPI_Gather(local_b, local_n, MPI_DOUBLE, b, local_n, MPI_DOUBLE, 0,
+         comm);
    }
 }  /* Print_vector */
-
-
-/*-------------------------------------------------------------------
- * Function:  Parallel_vector_sum
- * Purpose:   Add a vector that's been distributed among the processes
- * In args:   local_x:  local storage of one of the vectors being added
- *            local_y:  local storage for the second vector being added
- *            local_n:  the number of components in local_x, local_y,
- *                      and local_z
- * Out arg:   local_z:  local storage for the sum of the two vectors
- */
-void Parallel_vector_sum(
-      double  local_x[]  /* in  */,
-      double  local_y[]  /* in  */,
-      double  local_z[]  /* out */,
-      int     local_n    /* in  */) {
-   int local_i;
-
-   for (local_i = 0; local_i < local_n; local_i++)
-      local_z[local_i] = local_x[local_i] + local_y[local_i];
-}  /* Parallel_vector_sum */
@@ -4,7 +4,8 @@
  *           distribution of the vectors.  This version also
  *           illustrates the use of MPI_Scatter and MPI_Gather.
  *
- * Compile:  mpicc -g -Wall -o mpi_vector_add mpi_vector_add.c
+ * Compile:  mpicc -g -Wall -o mpi_vector_add3 mpi_vector_add3.c \
+ *              lab3_kernels.c lab3_kernels_mpi.c
  * Run:      mpiexec -n <comm_sz> ./vector_add
  *
  * Input:    The order of the vectors, n, and the vectors x and y
@@ -25,12 +26,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#include "lab3_kernels.h"
 #include <time.h>
 
 void Check_for_error(int local_ok, char fname[], char message[], MPI_Comm comm);
 void Allocate_vectors(double** local_x_pp, double** local_y_pp, double** local_z_pp, int local_n, MPI_Comm comm);
-double Parallel_dot_product(double local_x[], double local_y[], int local_n);
-void Parallel_scalar_multiplication(double local_x[], double local_y[], double scalar, int local_n);
 void Print_vector(double local_b[], int local_n, int n, char title[], int my_rank, MPI_Comm comm);
 
 int main(void) {
@@ -66,7 +66,7 @@ int main(void) {
    Print_vector(local_y, local_n, n, "Vector y (antes de multiplicar por escalar)", my_rank, comm);
 
    // Calcular producto punto
-   dot_product = Parallel_dot_product(local_x, local_y, local_n);
+   dot_product = Parallel_dot_product(local_x, local_y, local_n, comm);
 
    // Multiplicación por un escalar
    Parallel_scalar_multiplication(local_x, local_y, scalar, local_n);
@@ -101,23 +101,6 @@ void Allocate_vectors(double** local_x_pp, double** local_y_pp, double** local_z
    }
 }
 
-double Parallel_dot_product(double local_x[], double local_y[], int local_n) {
-   double local_dot_product = 0.0;
-   double global_dot_product = 0.0;
-   for (int i = 0; i < local_n; i++) {
-      local_dot_product += local_x[i] * local_y[i];
-   }
-   MPI_Reduce(&local_dot_product, &global_dot_product, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-   return global_dot_product;
-}
-
-void Parallel_scalar_multiplication(double local_x[], double local_y[], double scalar, int local_n) {
-   for (int i = 0; i < local_n; i++) {
-      local_x[i] *= scalar;
-      local_y[i] *= scalar;
-   }
-}
-
 void Print_vector(double local_b[], int local_n, int n, char title[], int my_rank, MPI_Comm comm) {
    double* b = NULL;
    if (my_rank == 0) {
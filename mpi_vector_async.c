@@ -0,0 +1,496 @@
+/* File:     mpi_vector_async.c
+ *
+ * Purpose:  Overlap many distributed vector operations with an async
+ *           API.  The operations (Async_scatter, Async_dot,
+ *           Async_gather) start nonblocking MPI operations and return
+ *           a request, and jobs are written as straight-line
+ *           coroutines that CO_AWAIT those requests.  A progress
+ *           engine polls the requests of all suspended coroutines with
+ *           MPI_Testsome and resumes each coroutine as soon as the
+ *           request it waits for completes, so the communication of
+ *           one job overlaps the communication and computation of the
+ *           others.
+ *
+ *           Each job scatters x and y from process 0, adds them,
+ *           finds x.y with a nonblocking allreduce and gathers
+ *           z = x + y onto process 0.  The program runs the jobs one
+ *           after the other with blocking calls, then all at once as
+ *           coroutines, checks both against a serial computation, and
+ *           prints the times.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_vector_async mpi_vector_async.c \
+ *              lab3_kernels.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_async [-n <n>] [-j <jobs>]
+ *
+ * Input:    None
+ * Output:   Elapsed times of the blocking and the coroutine runs, the
+ *           number of polls of the progress engine, and whether the
+ *           results are correct
+ *
+ * Notes:
+ * 1.  n (default 500000) is the order of the vectors of each job and
+ *     should be evenly divisible by comm_sz; jobs defaults to 8.
+ * 2.  The coroutines are stackless (the switch on __LINE__ trick):
+ *     a coroutine's variables that must survive a CO_AWAIT have to
+ *     live in its struct, not on the stack, and CO_AWAIT can't be
+ *     used inside a switch of the coroutine.
+ * 3.  Nonblocking collectives on a communicator must be started in
+ *     the same order on every process.  The coroutines are resumed in
+ *     the order their requests complete, which differs between
+ *     processes, so each job gets its own duplicate of the
+ *     communicator.
+ * 4.  The dot products are compared within a rounding tolerance, since
+ *     MPI_Iallreduce and the serial sum may add the terms in
+ *     different orders.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+/*-------------------------------------------------------------------
+ * Coroutines
+ *
+ * A coroutine is a function int fn(coroutine_t* co) whose body is
+ * enclosed in CO_BEGIN(co) ... CO_END(co).  Each call runs it from
+ * where it last suspended until the next CO_AWAIT of a request that
+ * hasn't completed (return 0) or the end of the body (return 1).
+ */
+typedef struct coroutine_s {
+   int           state;     /* resume point:  0 at the start        */
+   int           done;
+   int           (*fn)(struct coroutine_s* co);
+   MPI_Request*  waiting;   /* request it's suspended on, or NULL   */
+} coroutine_t;
+
+#define CO_BEGIN(co)  switch ((co)->state) { case 0:
+
+#define CO_AWAIT(co, req_p)                                             \
+   do {                                                                 \
+      (co)->state = __LINE__;                                           \
+      (co)->waiting = (req_p);                                          \
+      case __LINE__:                                                    \
+      if (!Request_done((co)->waiting)) return 0;                       \
+      (co)->waiting = NULL;                                             \
+   } while (0)
+
+#define CO_END(co)    } (co)->done = 1; return 1;
+
+#define MAX_JOBS 256
+
+/* One job:  z = x + y and x.y for one pair of vectors */
+typedef struct {
+   coroutine_t  co;          /* must be first */
+   int          n, local_n, my_rank;
+   double       *x, *y, *z;  /* full vectors, only on process 0 */
+   double       *local_x, *local_y, *local_z;
+   double       local_dot, dot;
+   MPI_Request  reqs[2];
+   MPI_Comm     comm;
+} job_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* jobs_p,
+      int comm_sz, MPI_Comm comm);
+int Request_done(MPI_Request* req_p);
+long Engine_run(coroutine_t* cos[], int count);
+void Async_scatter(double a[], double local_a[], int local_n,
+      MPI_Comm comm, MPI_Request* req_p);
+void Async_gather(double local_a[], double a[], int local_n,
+      MPI_Comm comm, MPI_Request* req_p);
+void Async_dot(double local_x[], double local_y[], int local_n,
+      double* local_dot_p, double* dot_p, MPI_Comm comm,
+      MPI_Request* req_p);
+int Job_co(coroutine_t* co);
+void Job_blocking(job_t* j);
+void Job_init(job_t* j, int job, int n, int local_n, int my_rank,
+      MPI_Comm comm);
+void Job_free(job_t* j);
+int Job_check(job_t* j);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, jobs, k, ok[2];
+   int comm_sz, my_rank;
+   long polls = 0;
+   double local_start, local_elapsed, elapsed[2];
+   job_t* job;
+   coroutine_t* cos[MAX_JOBS];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &jobs, comm_sz, comm);
+   job = malloc(jobs*sizeof(job_t));
+   Check_for_error(job != NULL, "main", "Can't allocate jobs", comm);
+   for (k = 0; k < jobs; k++)
+      Job_init(&job[k], k, n, n/comm_sz, my_rank, comm);
+
+   /* Blocking:  one job after the other.  The first, untimed, run
+    * touches the local vectors so neither timing includes page faults */
+   for (k = 0; k < jobs; k++)
+      Job_blocking(&job[k]);
+   MPI_Barrier(comm);
+   local_start = MPI_Wtime();
+   for (k = 0; k < jobs; k++)
+      Job_blocking(&job[k]);
+   local_elapsed = MPI_Wtime() - local_start;
+   MPI_Reduce(&local_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   ok[0] = 1;
+   for (k = 0; k < jobs; k++)
+      ok[0] = ok[0] && Job_check(&job[k]);
+
+   /* Coroutines:  all the jobs in flight.  Clear the results of the
+    * blocking run so they can't be mistaken for the new ones */
+   for (k = 0; k < jobs; k++) {
+      if (my_rank == 0) memset(job[k].z, 0, n*sizeof(double));
+      job[k].dot = -1.0;
+      job[k].co = (coroutine_t) {0, 0, Job_co, NULL};
+      cos[k] = &job[k].co;
+   }
+   MPI_Barrier(comm);
+   local_start = MPI_Wtime();
+   polls = Engine_run(cos, jobs);
+   local_elapsed = MPI_Wtime() - local_start;
+   MPI_Reduce(&local_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   ok[1] = 1;
+   for (k = 0; k < jobs; k++)
+      ok[1] = ok[1] && Job_check(&job[k]);
+
+   if (my_rank == 0) {
+      printf("%d jobs, n = %d\n", jobs, n);
+      printf("Blocking:    %e seconds, results %s\n", elapsed[0],
+            ok[0] ? "correct" : "WRONG");
+      printf("Coroutines:  %e seconds, results %s, %ld polls\n",
+            elapsed[1], ok[1] ? "correct" : "WRONG", polls);
+      printf("Speedup = %.2f\n", elapsed[0]/elapsed[1]);
+   }
+
+   for (k = 0; k < jobs; k++)
+      Job_free(&job[k]);
+   free(job);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors and the number of jobs from
+ *            the command line
+ * In args:   argc, argv, comm_sz, comm
+ * Out args:  n_p, jobs_p
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            and 1 <= jobs <= MAX_JOBS
+ */
+void Get_args(
+      int       argc     /* in  */,
+      char*     argv[]   /* in  */,
+      int*      n_p      /* out */,
+      int*      jobs_p   /* out */,
+      int       comm_sz  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int c, local_ok = 1;
+
+   *n_p = 500000;
+   *jobs_p = 8;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:j:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 'j': *jobs_p = strtol(optarg, NULL, 10); break;
+         default:  local_ok = 0;
+      }
+   Check_for_error(local_ok, "Get_args",
+         "usage: mpi_vector_async [-n <n>] [-j <jobs>]", comm);
+   Check_for_error(*n_p > 0 && *n_p % comm_sz == 0, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   Check_for_error(*jobs_p >= 1 && *jobs_p <= MAX_JOBS, "Get_args",
+         "jobs should be between 1 and 256", comm);
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:  Request_done
+ * Purpose:   Return 1 if the request has completed (or is null), 0
+ *            otherwise.  A completed request is set to
+ *            MPI_REQUEST_NULL.
+ * In/out:    req_p
+ */
+int Request_done(MPI_Request* req_p) {
+   int flag;
+
+   if (*req_p == MPI_REQUEST_NULL) return 1;
+   MPI_Test(req_p, &flag, MPI_STATUS_IGNORE);
+   return flag;
+}  /* Request_done */
+
+/*-------------------------------------------------------------------
+ * Function:  Engine_run
+ * Purpose:   Run coroutines until all of them have finished
+ * In/out:    cos:    the coroutines, none started
+ *            count:  number of coroutines (<= MAX_JOBS)
+ * Ret val:   Number of calls of MPI_Testsome
+ * Note:      Each poll tests the requests of all the suspended
+ *            coroutines with one MPI_Testsome and resumes the
+ *            coroutines whose requests completed.
+ */
+long Engine_run(coroutine_t* cos[], int count) {
+   MPI_Request reqs[MAX_JOBS];
+   coroutine_t* owner[MAX_JOBS];
+   int indices[MAX_JOBS], active = 0, waiting, completed, i;
+   long polls = 0;
+   coroutine_t* co;
+
+   for (i = 0; i < count; i++)
+      if (!cos[i]->fn(cos[i])) active++;
+
+   while (active > 0) {
+      waiting = 0;
+      for (i = 0; i < count; i++)
+         if (!cos[i]->done) {
+            reqs[waiting] = *cos[i]->waiting;
+            owner[waiting++] = cos[i];
+         }
+      MPI_Testsome(waiting, reqs, &completed, indices, MPI_STATUSES_IGNORE);
+      polls++;
+      if (completed == MPI_UNDEFINED) {
+         /* Every request was already null:  resume them all */
+         completed = waiting;
+         for (i = 0; i < waiting; i++)
+            indices[i] = i;
+      }
+      for (i = 0; i < completed; i++) {
+         co = owner[indices[i]];
+         *co->waiting = MPI_REQUEST_NULL;
+         if (co->fn(co)) active--;
+      }
+   }
+   return polls;
+}  /* Engine_run */
+
+/*-------------------------------------------------------------------
+ * Function:  Async_scatter
+ * Purpose:   Start distributing a vector on process 0 by blocks
+ * In args:   a:        the vector (significant on process 0)
+ *            local_n:  order of the blocks
+ *            comm
+ * Out args:  local_a:  the block of the calling process, valid once
+ *                      *req_p completes
+ *            req_p
+ */
+void Async_scatter(
+      double        a[]        /* in  */,
+      double        local_a[]  /* out */,
+      int           local_n    /* in  */,
+      MPI_Comm      comm       /* in  */,
+      MPI_Request*  req_p      /* out */) {
+   MPI_Iscatter(a, local_n, MPI_DOUBLE, local_a, local_n, MPI_DOUBLE, 0,
+         comm, req_p);
+}  /* Async_scatter */
+
+/*-------------------------------------------------------------------
+ * Function:  Async_gather
+ * Purpose:   Start collecting a block distributed vector onto
+ *            process 0
+ * In args:   local_a, local_n, comm
+ * Out args:  a:  the vector on process 0, valid once *req_p completes
+ *            req_p
+ */
+void Async_gather(
+      double        local_a[]  /* in  */,
+      double        a[]        /* out */,
+      int           local_n    /* in  */,
+      MPI_Comm      comm       /* in  */,
+      MPI_Request*  req_p      /* out */) {
+   MPI_Igather(local_a, local_n, MPI_DOUBLE, a, local_n, MPI_DOUBLE, 0,
+         comm, req_p);
+}  /* Async_gather */
+
+/*-------------------------------------------------------------------
+ * Function:  Async_dot
+ * Purpose:   Find the local dot product and start adding the local
+ *            dot products on every process
+ * In args:   local_x, local_y, local_n, comm
+ * Out args:  local_dot_p:  the local dot product; must stay valid
+ *                          until *req_p completes
+ *            dot_p:        x.y, valid once *req_p completes
+ *            req_p
+ */
+void Async_dot(
+      double        local_x[]    /* in  */,
+      double        local_y[]    /* in  */,
+      int           local_n      /* in  */,
+      double*       local_dot_p  /* out */,
+      double*       dot_p        /* out */,
+      MPI_Comm      comm         /* in  */,
+      MPI_Request*  req_p        /* out */) {
+   *local_dot_p = Dot_product(local_x, local_y, local_n);
+   MPI_Iallreduce(local_dot_p, dot_p, 1, MPI_DOUBLE, MPI_SUM, comm, req_p);
+}  /* Async_dot */
+
+/*-------------------------------------------------------------------
+ * Function:  Job_co
+ * Purpose:   The coroutine of a job
+ * In/out:    co:  the coroutine_t of a job_t
+ * Ret val:   1 when the job has finished, 0 when it's suspended
+ */
+int Job_co(coroutine_t* co) {
+   job_t* j = (job_t*) co;
+
+   CO_BEGIN(co);
+   Async_scatter(j->x, j->local_x, j->local_n, j->comm, &j->reqs[0]);
+   Async_scatter(j->y, j->local_y, j->local_n, j->comm, &j->reqs[1]);
+   CO_AWAIT(co, &j->reqs[0]);
+   CO_AWAIT(co, &j->reqs[1]);
+
+   Vector_sum(j->local_x, j->local_y, j->local_z, j->local_n);
+   Async_dot(j->local_x, j->local_y, j->local_n, &j->local_dot, &j->dot,
+         j->comm, &j->reqs[0]);
+   Async_gather(j->local_z, j->z, j->local_n, j->comm, &j->reqs[1]);
+   CO_AWAIT(co, &j->reqs[0]);
+   CO_AWAIT(co, &j->reqs[1]);
+   CO_END(co);
+}  /* Job_co */
+
+/*-------------------------------------------------------------------
+ * Function:  Job_blocking
+ * Purpose:   Run a job with blocking MPI calls
+ * In/out:    j
+ */
+void Job_blocking(job_t* j) {
+   int local_i;
+
+   MPI_Scatter(j->x, j->local_n, MPI_DOUBLE, j->local_x, j->local_n,
+         MPI_DOUBLE, 0, j->comm);
+   MPI_Scatter(j->y, j->local_n, MPI_DOUBLE, j->local_y, j->local_n,
+         MPI_DOUBLE, 0, j->comm);
+   Vector_sum(j->local_x, j->local_y, j->local_z, j->local_n);
+   j->local_dot = 0.0;
+   for (local_i = 0; local_i < j->local_n; local_i++)
+      j->local_dot += j->local_x[local_i]*j->local_y[local_i];
+   MPI_Allreduce(&j->local_dot, &j->dot, 1, MPI_DOUBLE, MPI_SUM, j->comm);
+   MPI_Gather(j->local_z, j->local_n, MPI_DOUBLE, j->z, j->local_n,
+         MPI_DOUBLE, 0, j->comm);
+}  /* Job_blocking */
+
+/*-------------------------------------------------------------------
+ * Function:  Job_init
+ * Purpose:   Allocate the vectors of a job, generate x and y on
+ *            process 0 and duplicate the communicator
+ * In args:   job, n, local_n, my_rank, comm
+ * Out arg:   j
+ *
+ * Errors:    malloc failure
+ */
+void Job_init(
+      job_t*    j        /* out */,
+      int       job      /* in  */,
+      int       n        /* in  */,
+      int       local_n  /* in  */,
+      int       my_rank  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int i, local_ok = 1;
+
+   j->n = n;
+   j->local_n = local_n;
+   j->my_rank = my_rank;
+   j->x = j->y = j->z = NULL;
+   if (my_rank == 0) {
+      j->x = malloc(n*sizeof(double));
+      j->y = malloc(n*sizeof(double));
+      j->z = malloc(n*sizeof(double));
+      if (j->x == NULL || j->y == NULL || j->z == NULL) local_ok = 0;
+   }
+   j->local_x = malloc(local_n*sizeof(double));
+   j->local_y = malloc(local_n*sizeof(double));
+   j->local_z = malloc(local_n*sizeof(double));
+   if (j->local_x == NULL || j->local_y == NULL || j->local_z == NULL)
+      local_ok = 0;
+   Check_for_error(local_ok, "Job_init", "Can't allocate vectors", comm);
+
+   if (my_rank == 0) {
+      srand(job + 1);
+      for (i = 0; i < n; i++) {
+         j->x[i] = (double) (rand() % 100);
+         j->y[i] = (double) (rand() % 100);
+      }
+   }
+   MPI_Comm_dup(comm, &j->comm);
+}  /* Job_init */
+
+/*-------------------------------------------------------------------
+ * Function:  Job_free
+ * Purpose:   Free the storage and the communicator of a job
+ * In/out:    j
+ */
+void Job_free(job_t* j) {
+   free(j->x); free(j->y); free(j->z);
+   free(j->local_x); free(j->local_y); free(j->local_z);
+   MPI_Comm_free(&j->comm);
+}  /* Job_free */
+
+/*-------------------------------------------------------------------
+ * Function:  Job_check
+ * Purpose:   Compare the results of a job with a serial computation
+ *            on process 0
+ * In arg:    j
+ * Ret val:   On process 0, 1 if z and the dot product are correct, 0
+ *            otherwise.  1 on the other processes.
+ */
+int Job_check(job_t* j) {
+   int i;
+   double dot = 0.0, abs_dot = 0.0;
+
+   if (j->my_rank != 0) return 1;
+   for (i = 0; i < j->n; i++) {
+      if (j->z[i] != j->x[i] + j->y[i]) return 0;
+      dot += j->x[i]*j->y[i];
+      abs_dot += fabs(j->x[i]*j->y[i]);
+   }
+   return fabs(j->dot - dot) <= j->n*DBL_EPSILON*abs_dot;
+}  /* Job_check */
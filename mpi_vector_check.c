@@ -0,0 +1,527 @@
+/* File:     mpi_vector_check.c
+ *
+ * Purpose:  Check the vector kernels of lab3_kernels.c, the ones
+ *           mpi_vector_add.c, mpi_vector_add2.c, mpi_vector_add3.c and
+ *           the benchmarks link, against serial reference versions.
+ *           For many vector orders n and for each distribution,
+ *           process 0 builds random x and y, distributes them, runs
+ *           the kernels on the blocks, collects the results and
+ *           compares them with the references:
+ *
+ *           - Parallel_vector_sum with z distinct from x and y, z == x,
+ *             z == y and x == y == z (its restrict, in-place and plain
+ *             paths), Vector_sum_restrict, Vector_add_in_place,
+ *             Vector_copy, Vector_scale, Vector_scale_in_place and
+ *             Parallel_scalar_multiplication must match exactly,
+ *           - Vector_triad must match within the rounding of a fused
+ *             multiply-add,
+ *           - Parallel_dot_product must match within a rounding
+ *             tolerance proportional to n*eps*sum|x[i]*y[i]|.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_vector_check mpi_vector_check.c \
+ *              lab3_kernels.c lab3_kernels_mpi.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_check [<trials> [<seed>]]
+ *           for p in 1 2 3 4 5 6 7 8; do
+ *              mpiexec --oversubscribe -n $p ./mpi_vector_check || break
+ *           done
+ *
+ * Input:    Optional command line args: the number of random orders
+ *           to try (default 100) and the seed of the random number
+ *           generator (default:  the time)
+ * Output:   A line for each failing case and a summary.  The exit
+ *           status is 0 if every case passed and 1 otherwise.
+ *
+ * Notes:
+ * 1.  Besides the random orders, every run tries n = 1, 2, 3,
+ *     comm_sz-1, comm_sz, comm_sz+1, 2*comm_sz-1 and 7*comm_sz, so
+ *     n < comm_sz and n not divisible by comm_sz are always covered.
+ * 2.  Distributions:  "block" is the distribution of mpi_vector_add.c,
+ *     with MPI_Scatter and MPI_Gather like its Read_vector and
+ *     Print_vector, and is only tried when comm_sz divides n;
+ *     "blockv" gives the first n % comm_sz processes one extra
+ *     element and uses MPI_Scatterv and MPI_Gatherv, so some
+ *     processes may have no elements at all.
+ * 3.  The references are written here, apart from the kernels,
+ *     so a bug in a kernel can't also be in its reference.
+ * 4.  The seed is printed with the summary so a failing run can be
+ *     repeated.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+typedef enum {DIST_BLOCK, DIST_BLOCKV} dist_t;
+
+/* One case:  the order, the distribution and where results go */
+typedef struct {
+   int       n;
+   int       local_n;
+   dist_t    dist;
+   int*      counts;    /* elements of each process           */
+   int*      displs;    /* global index of each first element */
+   double*   z;         /* gathered result, on process 0      */
+   int       my_rank;
+   MPI_Comm  comm;
+} check_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* trials_p, unsigned* seed_p,
+      int my_rank, MPI_Comm comm);
+int Get_distribution(int n, dist_t dist, int counts[], int displs[],
+      int comm_sz);
+int Check_case(int n, dist_t dist, unsigned seed, int my_rank,
+      int comm_sz, MPI_Comm comm);
+void Distribute(double a[], double local_a[], check_t* ck_p);
+void Collect(double local_a[], double a[], check_t* ck_p);
+int Compare(char kernel[], double local_z[], double ref[], double tol[],
+      check_t* ck_p);
+char* Dist_name(dist_t dist);
+void Reference_sum(double x[], double y[], double z[], int n);
+double Reference_dot(double x[], double y[], int n, double* abs_p);
+double Random(unsigned* seed_p);
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int trials, t, d, n, result, special_count;
+   int cases = 0, skipped = 0, failures = 0;
+   int comm_sz, my_rank;
+   int special[8];
+   unsigned seed, case_seed;
+   dist_t dists[] = {DIST_BLOCK, DIST_BLOCKV};
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &trials, &seed, my_rank, comm);
+   srand(seed);
+
+   special[0] = 1; special[1] = 2; special[2] = 3;
+   special[3] = comm_sz - 1; special[4] = comm_sz;
+   special[5] = comm_sz + 1; special[6] = 2*comm_sz - 1;
+   special[7] = 7*comm_sz;
+   special_count = 8;
+
+   for (t = 0; t < special_count + trials; t++) {
+      /* Every process draws the same numbers from the same seed */
+      if (t < special_count) n = special[t];
+      else if (t % 4 == 0) n = 1 + rand() % 200000;
+      else n = 1 + rand() % 2000;
+      case_seed = rand();
+      if (n <= 0) continue;
+      for (d = 0; d < 2; d++) {
+         result = Check_case(n, dists[d], case_seed, my_rank, comm_sz,
+               comm);
+         if (result < 0) {
+            skipped++;
+         } else {
+            cases++;
+            failures += result;
+         }
+      }
+   }
+
+   if (my_rank == 0)
+      printf("comm_sz = %d:  %d cases, %d skipped, %d failures "
+            "(seed %u)\n", comm_sz, cases, skipped, failures, seed);
+
+   MPI_Finalize();
+
+   return failures > 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the number of trials and the seed from the command
+ *            line.  The seed is broadcast from process 0 so every
+ *            process uses the same one.
+ * In args:   argc, argv:  command line
+ *            my_rank, comm:  usual MPI values
+ * Out args:  trials_p:  number of random orders to try
+ *            seed_p:    seed of the random number generator
+ *
+ * Errors:    trials should be >= 0
+ */
+void Get_args(
+      int        argc      /* in  */,
+      char*      argv[]    /* in  */,
+      int*       trials_p  /* out */,
+      unsigned*  seed_p    /* out */,
+      int        my_rank   /* in  */,
+      MPI_Comm   comm      /* in  */) {
+   *trials_p = 100;
+   *seed_p = (unsigned) time(NULL);
+   if (argc > 1) *trials_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *seed_p = (unsigned) strtoul(argv[2], NULL, 10);
+   MPI_Bcast(seed_p, 1, MPI_UNSIGNED, 0, comm);
+   Check_for_error(*trials_p >= 0, "Get_args", "trials should be >= 0",
+         comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_distribution
+ * Purpose:   Find the number of elements of each process and the
+ *            offset of its block for a distribution
+ * In args:   n:        order of the vector
+ *            dist:     the distribution
+ *            comm_sz:  number of processes
+ * Out args:  counts:   counts[q] = number of elements of process q
+ *            displs:   displs[q] = global index of q's first element
+ * Ret val:   1 if the distribution can be used for n, 0 otherwise
+ */
+int Get_distribution(
+      int     n          /* in  */,
+      dist_t  dist       /* in  */,
+      int     counts[]   /* out */,
+      int     displs[]   /* out */,
+      int     comm_sz    /* in  */) {
+   int q;
+
+   if (dist == DIST_BLOCK && n % comm_sz != 0) return 0;
+   for (q = 0; q < comm_sz; q++) {
+      counts[q] = n/comm_sz + (q < n % comm_sz);
+      displs[q] = q == 0 ? 0 : displs[q-1] + counts[q-1];
+   }
+   return 1;
+}  /* Get_distribution */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Check_case
+ * Purpose:   Run every kernel for one order and distribution and
+ *            compare the results with the references
+ * In args:   n:        order of the vectors
+ *            dist:     the distribution
+ *            seed:     seed of the random x and y
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Ret val:   The number of failures, on every process, or -1 if the
+ *            distribution can't be used for n
+ * Note:      x and y are never changed until the last kernel, so the
+ *            in-place kernels work on a copy in local_z
+ */
+int Check_case(
+      int       n        /* in */,
+      dist_t    dist     /* in */,
+      unsigned  seed     /* in */,
+      int       my_rank  /* in */,
+      int       comm_sz  /* in */,
+      MPI_Comm  comm     /* in */) {
+   double *x = NULL, *y = NULL, *z = NULL, *ref = NULL, *tol = NULL;
+   double *local_x, *local_y, *local_z;
+   int *counts, *displs, local_n, i, failures = 0, local_ok = 1;
+   double dot_ref, dot_abs, dot, dot_tol, scalar = 2.5;
+   size_t bytes;
+   check_t ck;
+
+   counts = malloc(2*comm_sz*sizeof(int));
+   Check_for_error(counts != NULL, "Check_case", "Can't allocate counts",
+         comm);
+   displs = counts + comm_sz;
+   if (!Get_distribution(n, dist, counts, displs, comm_sz)) {
+      free(counts);
+      return -1;
+   }
+   local_n = counts[my_rank];
+   bytes = local_n*sizeof(double);
+
+   if (my_rank == 0) {
+      x = malloc(n*sizeof(double));
+      y = malloc(n*sizeof(double));
+      z = malloc(n*sizeof(double));
+      ref = malloc(n*sizeof(double));
+      tol = malloc(n*sizeof(double));
+      if (x == NULL || y == NULL || z == NULL || ref == NULL ||
+            tol == NULL)
+         local_ok = 0;
+   }
+   local_x = malloc((local_n + 1)*sizeof(double));
+   local_y = malloc((local_n + 1)*sizeof(double));
+   local_z = malloc((local_n + 1)*sizeof(double));
+   if (local_x == NULL || local_y == NULL || local_z == NULL)
+      local_ok = 0;
+   Check_for_error(local_ok, "Check_case", "Can't allocate vectors", comm);
+
+   ck.n = n;
+   ck.local_n = local_n;
+   ck.dist = dist;
+   ck.counts = counts;
+   ck.displs = displs;
+   ck.z = z;
+   ck.my_rank = my_rank;
+   ck.comm = comm;
+
+   if (my_rank == 0)
+      for (i = 0; i < n; i++) {
+         x[i] = Random(&seed);
+         y[i] = Random(&seed);
+      }
+   Distribute(x, local_x, &ck);
+   Distribute(y, local_y, &ck);
+
+   /* z = x + y:  distinct blocks, the restrict kernel */
+   if (my_rank == 0) Reference_sum(x, y, ref, n);
+   Parallel_vector_sum(local_x, local_y, local_z, local_n);
+   failures += Compare("Parallel_vector_sum", local_z, ref, NULL, &ck);
+   memset(local_z, 0, bytes);
+   Vector_sum_restrict(local_x, local_y, local_z, local_n);
+   failures += Compare("Vector_sum_restrict", local_z, ref, NULL, &ck);
+
+   /* x += y and y += x:  the in-place paths */
+   memcpy(local_z, local_x, bytes);
+   Parallel_vector_sum(local_z, local_y, local_z, local_n);
+   failures += Compare("Parallel_vector_sum z == x", local_z, ref, NULL,
+         &ck);
+   memcpy(local_z, local_y, bytes);
+   Parallel_vector_sum(local_x, local_z, local_z, local_n);
+   failures += Compare("Parallel_vector_sum z == y", local_z, ref, NULL,
+         &ck);
+   memcpy(local_z, local_x, bytes);
+   Vector_add_in_place(local_z, local_y, local_n);
+   failures += Compare("Vector_add_in_place", local_z, ref, NULL, &ck);
+
+   /* z = x + x with x, y and z the same block:  the plain loop */
+   if (my_rank == 0) Reference_sum(x, x, ref, n);
+   memcpy(local_z, local_x, bytes);
+   Parallel_vector_sum(local_z, local_z, local_z, local_n);
+   failures += Compare("Parallel_vector_sum x == y == z", local_z, ref,
+         NULL, &ck);
+
+   /* x.y */
+   dot = Parallel_dot_product(local_x, local_y, local_n, comm);
+   if (my_rank == 0) {
+      dot_ref = Reference_dot(x, y, n, &dot_abs);
+      dot_tol = 2.0*(n + comm_sz)*DBL_EPSILON*dot_abs;
+      if (fabs(dot - dot_ref) > dot_tol) {
+         printf("FAIL %s n = %d:  Parallel_dot_product = %.17g, "
+               "expected %.17g (tol %g)\n", Dist_name(dist), n, dot,
+               dot_ref, dot_tol);
+         failures++;
+      }
+   }
+
+   /* The STREAM kernels:  c = a, b = scalar*c, a = b + scalar*c.  The
+      triad may be contracted to a fused multiply-add */
+   if (my_rank == 0) memcpy(ref, x, n*sizeof(double));
+   Vector_copy(local_x, local_z, local_n);
+   failures += Compare("Vector_copy", local_z, ref, NULL, &ck);
+   if (my_rank == 0)
+      for (i = 0; i < n; i++)
+         ref[i] = scalar*x[i];
+   Vector_scale(local_x, local_z, scalar, local_n);
+   failures += Compare("Vector_scale", local_z, ref, NULL, &ck);
+   if (my_rank == 0)
+      for (i = 0; i < n; i++) {
+         ref[i] = x[i] + scalar*y[i];
+         tol[i] = 2.0*DBL_EPSILON*(fabs(x[i]) + fabs(scalar*y[i]));
+      }
+   Vector_triad(local_x, local_y, local_z, scalar, local_n);
+   failures += Compare("Vector_triad", local_z, ref, tol, &ck);
+
+   /* x *= scalar, y *= scalar */
+   if (my_rank == 0)
+      for (i = 0; i < n; i++)
+         ref[i] = x[i]*scalar;
+   memcpy(local_z, local_x, bytes);
+   Vector_scale_in_place(local_z, scalar, local_n);
+   failures += Compare("Vector_scale_in_place", local_z, ref, NULL, &ck);
+   Parallel_scalar_multiplication(local_x, local_y, scalar, local_n);
+   failures += Compare("Parallel_scalar_multiplication x", local_x, ref,
+         NULL, &ck);
+   if (my_rank == 0)
+      for (i = 0; i < n; i++)
+         ref[i] = y[i]*scalar;
+   failures += Compare("Parallel_scalar_multiplication y", local_y, ref,
+         NULL, &ck);
+
+   MPI_Bcast(&failures, 1, MPI_INT, 0, comm);
+   free(x); free(y); free(z); free(ref); free(tol);
+   free(local_x); free(local_y); free(local_z);
+   free(counts);
+   return failures;
+}  /* Check_case */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Distribute
+ * Purpose:   Send the blocks of a vector on process 0 to the processes
+ *            with the distribution of the case:  MPI_Scatter, as in
+ *            mpi_vector_add.c's Read_vector, for block and
+ *            MPI_Scatterv for blockv
+ * In args:   a:     the vector, on process 0
+ *            ck_p:  the case
+ * Out arg:   local_a:  the block of the calling process
+ */
+void Distribute(
+      double    a[]        /* in  */,
+      double    local_a[]  /* out */,
+      check_t*  ck_p       /* in  */) {
+   if (ck_p->dist == DIST_BLOCK)
+      MPI_Scatter(a, ck_p->local_n, MPI_DOUBLE, local_a, ck_p->local_n,
+            MPI_DOUBLE, 0, ck_p->comm);
+   else
+      MPI_Scatterv(a, ck_p->counts, ck_p->displs, MPI_DOUBLE, local_a,
+            ck_p->local_n, MPI_DOUBLE, 0, ck_p->comm);
+}  /* Distribute */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Collect
+ * Purpose:   Gather the blocks of a vector onto process 0 with the
+ *            distribution of the case:  MPI_Gather, as in
+ *            mpi_vector_add.c's Print_vector, for block and
+ *            MPI_Gatherv for blockv
+ * In args:   local_a:  the block of the calling process
+ *            ck_p:     the case
+ * Out arg:   a:  the vector, on process 0
+ */
+void Collect(
+      double    local_a[]  /* in  */,
+      double    a[]        /* out */,
+      check_t*  ck_p       /* in  */) {
+   if (ck_p->dist == DIST_BLOCK)
+      MPI_Gather(local_a, ck_p->local_n, MPI_DOUBLE, a, ck_p->local_n,
+            MPI_DOUBLE, 0, ck_p->comm);
+   else
+      MPI_Gatherv(local_a, ck_p->local_n, MPI_DOUBLE, a, ck_p->counts,
+            ck_p->displs, MPI_DOUBLE, 0, ck_p->comm);
+}  /* Collect */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compare
+ * Purpose:   Collect the result of a kernel on process 0 and compare
+ *            it with the reference
+ * In args:   kernel:   name of the kernel, for the failure message
+ *            local_z:  block of the result
+ *            ref:      the reference, on process 0
+ *            tol:      tol[i] is the tolerance of element i, or NULL
+ *                      if the result must match exactly
+ *            ck_p:     the case; the result is gathered into ck_p->z
+ * Ret val:   1 on process 0 if the result doesn't match, 0 otherwise
+ */
+int Compare(
+      char      kernel[]   /* in */,
+      double    local_z[]  /* in */,
+      double    ref[]      /* in */,
+      double    tol[]      /* in */,
+      check_t*  ck_p       /* in */) {
+   int i;
+
+   Collect(local_z, ck_p->z, ck_p);
+   if (ck_p->my_rank != 0) return 0;
+   for (i = 0; i < ck_p->n; i++)
+      if (tol == NULL ? ck_p->z[i] != ref[i] :
+            fabs(ck_p->z[i] - ref[i]) > tol[i]) {
+         printf("FAIL %s n = %d:  %s at %d = %.17g, expected %.17g\n",
+               Dist_name(ck_p->dist), ck_p->n, kernel, i, ck_p->z[i],
+               ref[i]);
+         return 1;
+      }
+   return 0;
+}  /* Compare */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Dist_name
+ * Purpose:   Name of a distribution, for the messages
+ */
+char* Dist_name(dist_t dist /* in */) {
+   return dist == DIST_BLOCK ? "block" : "blockv";
+}  /* Dist_name */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Reference_sum
+ * Purpose:   Serial z = x + y, the reference of the sums
+ * In args:   x, y, n
+ * Out arg:   z
+ */
+void Reference_sum(
+      double  x[]  /* in  */,
+      double  y[]  /* in  */,
+      double  z[]  /* out */,
+      int     n    /* in  */) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      z[i] = x[i] + y[i];
+}  /* Reference_sum */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Reference_dot
+ * Purpose:   Serial x.y, the reference of the dot products
+ * In args:   x, y, n
+ * Out arg:   abs_p:  sum of |x[i]*y[i]|, for the tolerance
+ * Ret val:   x.y
+ */
+double Reference_dot(
+      double   x[]    /* in  */,
+      double   y[]    /* in  */,
+      int      n      /* in  */,
+      double*  abs_p  /* out */) {
+   int i;
+   double dot = 0.0;
+
+   *abs_p = 0.0;
+   for (i = 0; i < n; i++) {
+      dot += x[i]*y[i];
+      *abs_p += fabs(x[i]*y[i]);
+   }
+   return dot;
+}  /* Reference_dot */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Random
+ * Purpose:   Random element in [-100, 100] with two decimals
+ * In/out:    seed_p:  state of rand_r
+ */
+double Random(unsigned* seed_p /* in/out */) {
+   return (rand_r(seed_p) % 20001)/100.0 - 100.0;
+}  /* Random */
@@ -0,0 +1,357 @@
+/* File:     mpi_vector_redistribute.c
+ *
+ * Purpose:  Move a vector with a block distribution over p_old
+ *           processes to a block distribution over p_new processes,
+ *           so a running job can shrink or grow its set of processes
+ *           without reading the input again.  The vector is shrunk
+ *           from comm_sz processes to p_new and then grown back, and
+ *           after each move the blocks are checked and summed on the
+ *           communicator of the new set.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_vector_redistribute \
+ *              mpi_vector_redistribute.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_redistribute [-n <n>]
+ *                 [-N <p_new>]
+ *
+ * Input:    None
+ * Output:   For each move, the elements that changed process, their
+ *           percentage of n, the time, and whether the blocks and the
+ *           sum are right.  The exit status is 1 if any isn't.
+ *
+ * Notes:
+ * 1.  n defaults to 10000000 and needn't be divisible by the number of
+ *     processes:  process q of p owns [q*n/p, (q+1)*n/p).  p_new
+ *     defaults to (comm_sz + 1)/2 and should be between 1 and comm_sz.
+ * 2.  A set of p processes is processes 0 to p-1 of MPI_COMM_WORLD,
+ *     and its communicator comes from MPI_Comm_split.  The processes
+ *     outside the set own no elements.
+ * 3.  Redistribute sends each process only the overlap of its new
+ *     block with the old block of every other process, in a single
+ *     MPI_Alltoallv over MPI_COMM_WORLD; the overlap with its own old
+ *     block is copied locally.  So an element is moved only if its
+ *     owner changes, which is the least data motion for a block
+ *     distribution.
+ * 4.  The processes are expected to exist already (for instance
+ *     started with the largest size the job can grow to).  Processes
+ *     created with MPI_Comm_spawn would be joined to the job with
+ *     MPI_Intercomm_merge and then Redistribute works on the merged
+ *     communicator.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mpi.h>
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* p_new_p,
+      int comm_sz, MPI_Comm comm);
+void Block_range(int rank, int p, int n, int* lo_p, int* hi_p);
+double* Allocate_block(int p, int n, int my_rank, MPI_Comm comm);
+void Fill_block(double local_x[], int p, int n, int my_rank);
+long Redistribute(double local_old[], int p_old, double local_new[],
+      int p_new, int n, MPI_Comm comm);
+int Check_block(double local_x[], int p, int n, int my_rank,
+      MPI_Comm comm);
+int Move(double** local_x_pp, int p_old, int p_new, int n, int my_rank,
+      MPI_Comm comm);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, p_new, comm_sz, my_rank, ok;
+   double* local_x;
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &p_new, comm_sz, comm);
+   local_x = Allocate_block(comm_sz, n, my_rank, comm);
+   Fill_block(local_x, comm_sz, n, my_rank);
+
+   ok = Move(&local_x, comm_sz, p_new, n, my_rank, comm);
+   ok = Move(&local_x, p_new, comm_sz, n, my_rank, comm) && ok;
+
+   free(local_x);
+   MPI_Finalize();
+
+   return ok ? 0 : 1;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vector and the size of the new set
+ *            of processes from the command line
+ * In args:   argc, argv, comm_sz, comm
+ * Out args:  n_p, p_new_p
+ *
+ * Errors:    n should be positive and p_new between 1 and comm_sz
+ */
+void Get_args(
+      int       argc     /* in  */,
+      char*     argv[]   /* in  */,
+      int*      n_p      /* out */,
+      int*      p_new_p  /* out */,
+      int       comm_sz  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int c, local_ok = 1;
+
+   *n_p = 10000000;
+   *p_new_p = (comm_sz + 1)/2;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:N:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 'N': *p_new_p = strtol(optarg, NULL, 10); break;
+         default:  local_ok = 0;
+      }
+   Check_for_error(local_ok, "Get_args",
+         "usage: mpi_vector_redistribute [-n <n>] [-N <p_new>]", comm);
+   Check_for_error(*n_p > 0, "Get_args", "n should be > 0", comm);
+   Check_for_error(*p_new_p >= 1 && *p_new_p <= comm_sz, "Get_args",
+         "p_new should be between 1 and comm_sz", comm);
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:  Block_range
+ * Purpose:   Find the block of a process in a block distribution over
+ *            p processes
+ * In args:   rank, p, n
+ * Out args:  lo_p, hi_p:  the block is [*lo_p, *hi_p), empty if
+ *               rank >= p
+ */
+void Block_range(
+      int   rank  /* in  */,
+      int   p     /* in  */,
+      int   n     /* in  */,
+      int*  lo_p  /* out */,
+      int*  hi_p  /* out */) {
+   if (rank >= p) {
+      *lo_p = *hi_p = 0;
+   } else {
+      *lo_p = (long) rank*n/p;
+      *hi_p = (long) (rank + 1)*n/p;
+   }
+}  /* Block_range */
+
+/*-------------------------------------------------------------------
+ * Function:  Allocate_block
+ * Purpose:   Allocate the block of the calling process in a block
+ *            distribution over p processes
+ * In args:   p, n, my_rank, comm
+ * Ret val:   The block (at least one element, so it isn't NULL when
+ *            it's empty)
+ *
+ * Errors:    malloc failure
+ */
+double* Allocate_block(
+      int       p        /* in */,
+      int       n        /* in */,
+      int       my_rank  /* in */,
+      MPI_Comm  comm     /* in */) {
+   int lo, hi;
+   double* local_x;
+
+   Block_range(my_rank, p, n, &lo, &hi);
+   local_x = malloc((hi - lo + 1)*sizeof(double));
+   Check_for_error(local_x != NULL, "Allocate_block",
+         "Can't allocate local vector", comm);
+   return local_x;
+}  /* Allocate_block */
+
+/*-------------------------------------------------------------------
+ * Function:  Fill_block
+ * Purpose:   Set each element of the vector to its global index
+ * In args:   p, n, my_rank
+ * Out arg:   local_x
+ */
+void Fill_block(
+      double  local_x[]  /* out */,
+      int     p          /* in  */,
+      int     n          /* in  */,
+      int     my_rank    /* in  */) {
+   int lo, hi, i;
+
+   Block_range(my_rank, p, n, &lo, &hi);
+   for (i = lo; i < hi; i++)
+      local_x[i - lo] = i;
+}  /* Fill_block */
+
+/*-------------------------------------------------------------------
+ * Function:  Redistribute
+ * Purpose:   Move a vector from a block distribution over p_old
+ *            processes to one over p_new processes
+ * In args:   local_old:  block of the calling process over p_old
+ *            p_old, p_new, n
+ *            comm:       communicator with at least max(p_old, p_new)
+ *                        processes
+ * Out arg:   local_new:  block of the calling process over p_new
+ * Ret val:   The elements sent to other processes by all the processes
+ *
+ * Errors:    malloc failure
+ */
+long Redistribute(
+      double    local_old[]  /* in  */,
+      int       p_old        /* in  */,
+      double    local_new[]  /* out */,
+      int       p_new        /* in  */,
+      int       n            /* in  */,
+      MPI_Comm  comm         /* in  */) {
+   int comm_sz, my_rank, q, lo, hi;
+   int old_lo, old_hi, new_lo, new_hi, q_lo, q_hi;
+   int *send_counts, *send_displs, *recv_counts, *recv_displs;
+   long local_moved = 0, moved;
+
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+   send_counts = malloc(4*comm_sz*sizeof(int));
+   Check_for_error(send_counts != NULL, "Redistribute",
+         "Can't allocate counts", comm);
+   send_displs = send_counts + comm_sz;
+   recv_counts = send_displs + comm_sz;
+   recv_displs = recv_counts + comm_sz;
+
+   Block_range(my_rank, p_old, n, &old_lo, &old_hi);
+   Block_range(my_rank, p_new, n, &new_lo, &new_hi);
+   for (q = 0; q < comm_sz; q++) {
+      /* My old block overlapping q's new block */
+      Block_range(q, p_new, n, &q_lo, &q_hi);
+      lo = old_lo > q_lo ? old_lo : q_lo;
+      hi = old_hi < q_hi ? old_hi : q_hi;
+      send_counts[q] = hi > lo && q != my_rank ? hi - lo : 0;
+      send_displs[q] = send_counts[q] > 0 ? lo - old_lo : 0;
+      local_moved += send_counts[q];
+      if (hi > lo && q == my_rank)
+         memcpy(local_new + lo - new_lo, local_old + lo - old_lo,
+               (hi - lo)*sizeof(double));
+
+      /* q's old block overlapping my new block */
+      Block_range(q, p_old, n, &q_lo, &q_hi);
+      lo = new_lo > q_lo ? new_lo : q_lo;
+      hi = new_hi < q_hi ? new_hi : q_hi;
+      recv_counts[q] = hi > lo && q != my_rank ? hi - lo : 0;
+      recv_displs[q] = recv_counts[q] > 0 ? lo - new_lo : 0;
+   }
+
+   MPI_Alltoallv(local_old, send_counts, send_displs, MPI_DOUBLE,
+         local_new, recv_counts, recv_displs, MPI_DOUBLE, comm);
+   MPI_Allreduce(&local_moved, &moved, 1, MPI_LONG, MPI_SUM, comm);
+
+   free(send_counts);
+   return moved;
+}  /* Redistribute */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_block
+ * Purpose:   Check that every element of the vector is its global
+ *            index, and that the sum over the communicator of the set
+ *            of processes is n(n-1)/2
+ * In args:   local_x, p, n, my_rank
+ *            comm:  communicator containing all the processes
+ * Ret val:   1 if the vector is right, 0 otherwise
+ */
+int Check_block(
+      double    local_x[]  /* in */,
+      int       p          /* in */,
+      int       n          /* in */,
+      int       my_rank    /* in */,
+      MPI_Comm  comm       /* in */) {
+   int lo, hi, i, local_ok = 1, ok;
+   double local_sum = 0.0, sum = 0.0;
+   MPI_Comm set_comm;
+
+   Block_range(my_rank, p, n, &lo, &hi);
+   for (i = lo; i < hi; i++) {
+      if (local_x[i - lo] != i) local_ok = 0;
+      local_sum += local_x[i - lo];
+   }
+
+   /* The sum only involves the processes of the set */
+   MPI_Comm_split(comm, my_rank < p ? 0 : MPI_UNDEFINED, my_rank,
+         &set_comm);
+   if (set_comm != MPI_COMM_NULL) {
+      MPI_Allreduce(&local_sum, &sum, 1, MPI_DOUBLE, MPI_SUM, set_comm);
+      if (sum != 0.5*n*((double) n - 1)) local_ok = 0;
+      MPI_Comm_free(&set_comm);
+   }
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   return ok;
+}  /* Check_block */
+
+/*-------------------------------------------------------------------
+ * Function:  Move
+ * Purpose:   Redistribute the vector from p_old to p_new processes,
+ *            replacing the block of the calling process, and print the
+ *            elements moved, the time and the check on process 0
+ * In args:   p_old, p_new, n, my_rank, comm
+ * In/out:    local_x_pp:  the block over p_old on input, over p_new on
+ *               output
+ * Ret val:   1 if the vector is right after the move, 0 otherwise
+ */
+int Move(
+      double**  local_x_pp  /* in/out */,
+      int       p_old       /* in     */,
+      int       p_new       /* in     */,
+      int       n           /* in     */,
+      int       my_rank     /* in     */,
+      MPI_Comm  comm        /* in     */) {
+   double* local_new;
+   double start, local_elapsed, elapsed;
+   long moved;
+   int ok;
+
+   local_new = Allocate_block(p_new, n, my_rank, comm);
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   moved = Redistribute(*local_x_pp, p_old, local_new, p_new, n, comm);
+   local_elapsed = MPI_Wtime() - start;
+   MPI_Reduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   free(*local_x_pp);
+   *local_x_pp = local_new;
+
+   ok = Check_block(local_new, p_new, n, my_rank, comm);
+   if (my_rank == 0)
+      printf("%d -> %d processes:  moved %ld of %d elements (%.1f%%) "
+            "in %.3f ms, %s\n", p_old, p_new, moved, n, 100.0*moved/n,
+            1000*elapsed, ok ? "correct" : "WRONG");
+   return ok;
+}  /* Move */
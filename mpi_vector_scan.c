@@ -0,0 +1,538 @@
+/* File:     mpi_vector_scan.c
+ *
+ * Purpose:  Implement inclusive and exclusive prefix "sums" (scans)
+ *           of a vector that has a block distribution.  The
+ *           operator can be sum, min, max or any user supplied
+ *           associative function.
+ *
+ *           Each process scans its block with its threads in two
+ *           passes:
+ *
+ *           1.  every thread reduces its piece of the block (a plain
+ *               reduction, which vectorizes), and the totals of the
+ *               blocks are combined across the processes with
+ *               MPI_Exscan;
+ *           2.  every thread scans its piece starting from the
+ *               combined total of everything before it.
+ *
+ *           Starting the second pass from the right offset means the
+ *           block is only read twice and written once, with no
+ *           separate pass to add the offsets.
+ *
+ * Compile:  mpicc -O3 -Wall [-fopenmp] -o mpi_vector_scan mpi_vector_scan.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_scan [<n> [<thread_count>]]
+ *
+ * Input:    Optional command line args: the order of the vector n
+ *           (default 10000000) and the number of threads per process
+ *           (default 1, and it can't be more than 1 if the program
+ *           is compiled without OpenMP)
+ * Output:   For each operator, the time of the distributed inclusive
+ *           and exclusive scans and of gathering the vector to
+ *           process 0 and scanning it there, and the maximum
+ *           difference between the two results.
+ *
+ * Notes:
+ * 1.  The order of the vector, n, should be evenly divisible
+ *     by comm_sz
+ * 2.  A user operator is a C function together with its identity;
+ *     Create_op wraps it in an MPI_Op for the MPI_Exscan.  The
+ *     example user operator is hypot, so the inclusive scan is the
+ *     running Euclidean norm of the vector.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.), Section 5.5 (OpenMP)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MAX_THREADS 256
+
+typedef enum {SCAN_SUM, SCAN_MIN, SCAN_MAX, SCAN_USER} scan_kind_t;
+typedef double (*scan_fn_t)(double a, double b);
+
+typedef struct {
+   char*        name;
+   scan_kind_t  kind;
+   scan_fn_t    fn;         /* combining function             */
+   double       identity;   /* fn(identity, a) == a           */
+   MPI_Op       mpi_op;     /* same operator for MPI_Exscan   */
+} scan_op_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* thread_count_p,
+      int comm_sz, MPI_Comm comm);
+double Sum(double a, double b);
+double Min(double a, double b);
+double Max(double a, double b);
+void Create_op(scan_op_t* op_p, char name[], scan_fn_t fn,
+      double identity);
+void User_op_fn(void* in, void* inout, int* len, MPI_Datatype* type);
+double Reduce_piece(const double a[], int n, scan_op_t* op_p);
+void Scan_piece(const double a[], double b[], int n, double offset,
+      int inclusive, scan_op_t* op_p);
+void Parallel_scan(double local_a[], double local_b[], int local_n,
+      int inclusive, scan_op_t* op_p, int thread_count, MPI_Comm comm);
+void Gather_scan(double local_a[], double local_b[], int local_n, int n,
+      int inclusive, scan_op_t* op_p, int my_rank, MPI_Comm comm);
+double Max_diff(double local_a[], double local_b[], int local_n,
+      MPI_Comm comm);
+
+/* The user function used by User_op_fn:  set by Create_op */
+static scan_fn_t user_fn;
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, local_n, local_i, thread_count, o, inclusive;
+   int comm_sz, my_rank;
+   double *local_a, *local_b, *local_c;
+   double start, finish, loc_elapsed, elapsed[2], diff;
+   scan_op_t ops[4];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &thread_count, comm_sz, comm);
+   local_n = n/comm_sz;
+
+   local_a = malloc(local_n*sizeof(double));
+   local_b = malloc(local_n*sizeof(double));
+   local_c = malloc(local_n*sizeof(double));
+   Check_for_error(local_a != NULL && local_b != NULL && local_c != NULL,
+         "main", "Can't allocate local vector(s)", comm);
+
+   srand(time(NULL) + my_rank);
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_a[local_i] = (double)(rand() % 100);
+
+   Create_op(&ops[0], "sum", Sum, 0.0);
+   Create_op(&ops[1], "min", Min, INFINITY);
+   Create_op(&ops[2], "max", Max, -INFINITY);
+   Create_op(&ops[3], "hypot", hypot, 0.0);
+
+   if (my_rank == 0)
+      printf("n = %d, comm_sz = %d, threads = %d\n", n, comm_sz,
+            thread_count);
+   for (o = 0; o < 4; o++)
+      for (inclusive = 1; inclusive >= 0; inclusive--) {
+         MPI_Barrier(comm);
+         start = MPI_Wtime();
+         Parallel_scan(local_a, local_b, local_n, inclusive, &ops[o],
+               thread_count, comm);
+         finish = MPI_Wtime();
+         loc_elapsed = finish-start;
+         MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0,
+               comm);
+
+         MPI_Barrier(comm);
+         start = MPI_Wtime();
+         Gather_scan(local_a, local_c, local_n, n, inclusive, &ops[o],
+               my_rank, comm);
+         finish = MPI_Wtime();
+         loc_elapsed = finish-start;
+         MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0,
+               comm);
+
+         diff = Max_diff(local_b, local_c, local_n, comm);
+         if (my_rank == 0)
+            printf("%-5s %s:  distributed %f ms, gather to 0 %f ms, "
+                  "max diff %e\n", ops[o].name,
+                  inclusive ? "inclusive" : "exclusive",
+                  elapsed[0]*1000, elapsed[1]*1000, diff);
+      }
+
+   for (o = 0; o < 4; o++)
+      if (ops[o].kind == SCAN_USER) MPI_Op_free(&ops[o].mpi_op);
+   free(local_a);
+   free(local_b);
+   free(local_c);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vector and the number of threads
+ *            from the command line
+ * In args:   argc, argv:  command line
+ *            comm_sz, comm:  usual MPI values
+ * Out args:  n_p:             order of the vector
+ *            thread_count_p:  threads per process
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            and 1 <= thread_count <= MAX_THREADS (thread_count = 1
+ *            if the program wasn't compiled with OpenMP)
+ */
+void Get_args(
+      int       argc             /* in  */,
+      char*     argv[]           /* in  */,
+      int*      n_p              /* out */,
+      int*      thread_count_p   /* out */,
+      int       comm_sz          /* in  */,
+      MPI_Comm  comm             /* in  */) {
+   int local_ok = 1;
+
+   *n_p = 10000000;
+   *thread_count_p = 1;
+   if (argc > 1) *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *thread_count_p = strtol(argv[2], NULL, 10);
+
+   if (*n_p <= 0 || *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*thread_count_p < 1 || *thread_count_p > MAX_THREADS)
+      local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "thread_count should be between 1 and MAX_THREADS", comm);
+#  ifndef _OPENMP
+   Check_for_error(*thread_count_p == 1, "Get_args",
+         "thread_count should be 1 without OpenMP", comm);
+#  endif
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Functions:  Sum, Min, Max
+ * Purpose:    The built-in scan operators
+ */
+double Sum(double a, double b) { return a + b; }
+double Min(double a, double b) { return b < a ? b : a; }
+double Max(double a, double b) { return b > a ? b : a; }
+
+
+/*-------------------------------------------------------------------
+ * Function:  Create_op
+ * Purpose:   Set up a scan operator.  Sum, Min and Max map to the
+ *            predefined MPI operators and to specialized local loops;
+ *            any other function becomes a user defined MPI_Op.
+ * In args:   name:      name used in the output
+ *            fn:        associative combining function
+ *            identity:  identity element of fn
+ * Out arg:   op_p:      the operator
+ *
+ * Note:      Only one user function can be in use at a time, since
+ *            MPI_User_function has no argument to carry it.  The
+ *            MPI_Op is created non-commutative, so MPI combines the
+ *            operands in rank order, as the local scan does.
+ */
+void Create_op(
+      scan_op_t*  op_p      /* out */,
+      char        name[]    /* in  */,
+      scan_fn_t   fn        /* in  */,
+      double      identity  /* in  */) {
+   op_p->name = name;
+   op_p->fn = fn;
+   op_p->identity = identity;
+   if (fn == Sum) {
+      op_p->kind = SCAN_SUM;
+      op_p->mpi_op = MPI_SUM;
+   } else if (fn == Min) {
+      op_p->kind = SCAN_MIN;
+      op_p->mpi_op = MPI_MIN;
+   } else if (fn == Max) {
+      op_p->kind = SCAN_MAX;
+      op_p->mpi_op = MPI_MAX;
+   } else {
+      op_p->kind = SCAN_USER;
+      user_fn = fn;
+      MPI_Op_create(User_op_fn, 0, &op_p->mpi_op);
+   }
+}  /* Create_op */
+
+
+/*-------------------------------------------------------------------
+ * Function:  User_op_fn
+ * Purpose:   MPI_User_function that applies user_fn elementwise:
+ *            inout[i] = user_fn(in[i], inout[i])
+ */
+void User_op_fn(
+      void*          in     /* in     */,
+      void*          inout  /* in/out */,
+      int*           len    /* in     */,
+      MPI_Datatype*  type   /* in     */) {
+   double* a = in;
+   double* b = inout;
+   int i;
+
+   for (i = 0; i < *len; i++)
+      b[i] = user_fn(a[i], b[i]);
+}  /* User_op_fn */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Reduce_piece
+ * Purpose:   Combine all the elements of an array with an operator
+ * In args:   a, n:  the array
+ *            op_p:  the operator
+ * Ret val:   a[0] op a[1] op ... op a[n-1] (identity if n == 0)
+ *
+ * Note:      The built-in operators use plain reduction loops that
+ *            the compiler vectorizes.
+ */
+double Reduce_piece(
+      const double  a[]   /* in */,
+      int           n     /* in */,
+      scan_op_t*    op_p  /* in */) {
+   int i;
+   double total = op_p->identity;
+
+   switch (op_p->kind) {
+      case SCAN_SUM:
+#        pragma omp simd reduction(+: total)
+         for (i = 0; i < n; i++) total += a[i];
+         break;
+      case SCAN_MIN:
+#        pragma omp simd reduction(min: total)
+         for (i = 0; i < n; i++) total = a[i] < total ? a[i] : total;
+         break;
+      case SCAN_MAX:
+#        pragma omp simd reduction(max: total)
+         for (i = 0; i < n; i++) total = a[i] > total ? a[i] : total;
+         break;
+      default:
+         for (i = 0; i < n; i++) total = op_p->fn(total, a[i]);
+   }
+   return total;
+}  /* Reduce_piece */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Scan_piece
+ * Purpose:   Scan an array starting from offset
+ * In args:   a, n:       the array
+ *            offset:     combined value of everything before a[0]
+ *            inclusive:  1 for an inclusive scan, 0 for exclusive
+ *            op_p:       the operator
+ * Out arg:   b:          b[i] = offset op a[0] op ... op a[i]
+ *                        (inclusive) or ... op a[i-1] (exclusive)
+ */
+void Scan_piece(
+      const double  a[]        /* in  */,
+      double        b[]        /* out */,
+      int           n          /* in  */,
+      double        offset     /* in  */,
+      int           inclusive  /* in  */,
+      scan_op_t*    op_p       /* in  */) {
+   int i;
+   double run = offset, ai;
+
+   switch (op_p->kind) {
+      case SCAN_SUM:
+         if (inclusive)
+            for (i = 0; i < n; i++) b[i] = run += a[i];
+         else
+            for (i = 0; i < n; i++) { ai = a[i]; b[i] = run; run += ai; }
+         break;
+      case SCAN_MIN:
+         for (i = 0; i < n; i++) {
+            ai = a[i];
+            if (!inclusive) b[i] = run;
+            run = ai < run ? ai : run;
+            if (inclusive) b[i] = run;
+         }
+         break;
+      case SCAN_MAX:
+         for (i = 0; i < n; i++) {
+            ai = a[i];
+            if (!inclusive) b[i] = run;
+            run = ai > run ? ai : run;
+            if (inclusive) b[i] = run;
+         }
+         break;
+      default:
+         for (i = 0; i < n; i++) {
+            ai = a[i];
+            if (!inclusive) b[i] = run;
+            run = op_p->fn(run, ai);
+            if (inclusive) b[i] = run;
+         }
+   }
+}  /* Scan_piece */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_scan
+ * Purpose:   Scan a block distributed vector
+ * In args:   local_a:       local block of the input vector
+ *            local_n:       order of the local block
+ *            inclusive:     1 for an inclusive scan, 0 for exclusive
+ *            op_p:          the operator
+ *            thread_count:  number of threads to use on each process
+ *            comm:          communicator containing the calling
+ *                           processes
+ * Out arg:   local_b:       local block of the scanned vector.  May
+ *                           be the same array as local_a.
+ */
+void Parallel_scan(
+      double      local_a[]     /* in  */,
+      double      local_b[]     /* out */,
+      int         local_n       /* in  */,
+      int         inclusive     /* in  */,
+      scan_op_t*  op_p          /* in  */,
+      int         thread_count  /* in  */,
+      MPI_Comm    comm          /* in  */) {
+   double totals[MAX_THREADS];
+   double local_total, offset;
+   int t, my_rank;
+
+   /* Pass 1:  reduce each thread's piece */
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int my_t = 0;
+#     ifdef _OPENMP
+      my_t = omp_get_thread_num();
+#     endif
+      int first = (long) local_n*my_t/thread_count;
+      int last = (long) local_n*(my_t + 1)/thread_count;
+      totals[my_t] = Reduce_piece(local_a + first, last - first, op_p);
+   }
+
+   local_total = op_p->identity;
+   for (t = 0; t < thread_count; t++)
+      local_total = op_p->fn(local_total, totals[t]);
+
+   /* MPI_Exscan leaves the receive buffer undefined on process 0 */
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Exscan(&local_total, &offset, 1, MPI_DOUBLE, op_p->mpi_op, comm);
+   if (my_rank == 0) offset = op_p->identity;
+
+   /* totals[t] becomes the offset of thread t's piece */
+   for (t = 0; t < thread_count; t++) {
+      double piece_total = totals[t];
+      totals[t] = offset;
+      offset = op_p->fn(offset, piece_total);
+   }
+
+   /* Pass 2:  scan each thread's piece from its offset */
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int my_t = 0;
+#     ifdef _OPENMP
+      my_t = omp_get_thread_num();
+#     endif
+      int first = (long) local_n*my_t/thread_count;
+      int last = (long) local_n*(my_t + 1)/thread_count;
+      Scan_piece(local_a + first, local_b + first, last - first,
+            totals[my_t], inclusive, op_p);
+   }
+}  /* Parallel_scan */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Gather_scan
+ * Purpose:   Scan a block distributed vector by gathering it to
+ *            process 0, scanning it serially and scattering the
+ *            result:  the reference for Parallel_scan.
+ * In args:   local_a:    local block of the input vector
+ *            local_n:    order of the local block
+ *            n:          order of the vector
+ *            inclusive:  1 for an inclusive scan, 0 for exclusive
+ *            op_p:       the operator
+ *            my_rank, comm:  usual MPI values
+ * Out arg:   local_b:    local block of the scanned vector
+ *
+ * Errors:    if process 0 can't allocate temporary storage for the
+ *            full vector, the program terminates.
+ */
+void Gather_scan(
+      double      local_a[]  /* in  */,
+      double      local_b[]  /* out */,
+      int         local_n    /* in  */,
+      int         n          /* in  */,
+      int         inclusive  /* in  */,
+      scan_op_t*  op_p       /* in  */,
+      int         my_rank    /* in  */,
+      MPI_Comm    comm       /* in  */) {
+   double* a = NULL;
+   int local_ok = 1;
+
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "Gather_scan",
+         "Can't allocate temporary vector", comm);
+   MPI_Gather(local_a, local_n, MPI_DOUBLE, a, local_n, MPI_DOUBLE, 0,
+         comm);
+   if (my_rank == 0)
+      Scan_piece(a, a, n, op_p->identity, inclusive, op_p);
+   MPI_Scatter(a, local_n, MPI_DOUBLE, local_b, local_n, MPI_DOUBLE, 0,
+         comm);
+   free(a);
+}  /* Gather_scan */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Find the largest absolute difference between the
+ *            entries of two distributed vectors
+ * In args:   local_a, local_b:  local blocks of the vectors
+ *            local_n:  order of the local blocks
+ *            comm:     communicator containing the calling processes
+ * Ret val:   max |a[i] - b[i]| on process 0
+ *
+ * Note:      Entries that are equal (including equal infinities)
+ *            count as a difference of 0.
+ */
+double Max_diff(
+      double    local_a[]  /* in */,
+      double    local_b[]  /* in */,
+      int       local_n    /* in */,
+      MPI_Comm  comm       /* in */) {
+   int local_i;
+   double d, local_max = 0.0, max = 0.0;
+
+   for (local_i = 0; local_i < local_n; local_i++) {
+      d = local_a[local_i] == local_b[local_i] ? 0.0 :
+            fabs(local_a[local_i] - local_b[local_i]);
+      if (d > local_max) local_max = d;
+   }
+   MPI_Reduce(&local_max, &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+   return max;
+}  /* Max_diff */
@@ -0,0 +1,606 @@
+/* File:     mpi_vector_sort.c
+ *
+ * Purpose:  Compute z = x + y on block distributed vectors and then
+ *           find the k largest elements of z and sort z without
+ *           gathering it to one process:
+ *
+ *           - top-k:  each process keeps the k largest elements of
+ *             its block in a min-heap, and the lists are merged up a
+ *             binary tree to process 0;
+ *           - sample sort:  each process sorts its block, regular
+ *             samples of all the blocks pick comm_sz-1 splitters,
+ *             and MPI_Alltoallv sends every element to the process
+ *             that owns its range.  After the exchange process q
+ *             holds the q-th range of z, sorted.
+ *
+ *           Both are compared with gathering z to process 0 and
+ *           using qsort.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_vector_sort mpi_vector_sort.c \
+ *              lab3_kernels.c
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_sort [<n> [<k>]]
+ *
+ * Input:    Optional command line args: the order of the vectors n
+ *           (default 10000000) and k (default 10)
+ * Output:   The k largest elements of z, run times of the
+ *           distributed and the gather-and-qsort versions, and
+ *           whether the results agree.
+ *
+ * Notes:
+ * 1.  The order of the vectors, n, should be evenly divisible
+ *     by comm_sz
+ * 2.  The local sort is an LSD radix sort on the bit patterns of the
+ *     doubles:  its passes are branch-free counting loops instead of
+ *     the data-dependent branches of a comparison sort.
+ *
+ * IPP:  Section 3.7.2 (parallel sorting)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <mpi.h>
+#include "lab3_kernels.h"
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* k_p, int comm_sz,
+      MPI_Comm comm);
+void Radix_sort(double a[], double tmp[], int n);
+void Heap_sift_down(double heap[], int size, int i);
+int Local_top_k(double local_a[], int local_n, int k, double top[]);
+int Merge_top_k(double a[], int a_n, double b[], int b_n, int k,
+      double c[]);
+int Parallel_top_k(double local_a[], int local_n, int k, double top[],
+      int my_rank, int comm_sz, MPI_Comm comm);
+int Parallel_sample_sort(double local_a[], int local_n, double** bucket_pp,
+      int my_rank, int comm_sz, MPI_Comm comm);
+double* Gather_and_qsort(double local_a[], int local_n, int n,
+      int my_rank, MPI_Comm comm);
+int Compare_double(const void* a_p, const void* b_p);
+int Check_sample_sort(double bucket[], int bucket_n, double sorted[],
+      int n, int my_rank, int comm_sz, MPI_Comm comm);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, k, local_n, local_i, top_n, bucket_n, i, ok;
+   int comm_sz, my_rank;
+   double *local_x, *local_y, *local_z, *top, *bucket, *sorted;
+   double start, finish, loc_elapsed, elapsed[3];
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &k, comm_sz, comm);
+   local_n = n/comm_sz;
+
+   local_x = malloc(local_n*sizeof(double));
+   local_y = malloc(local_n*sizeof(double));
+   local_z = malloc(local_n*sizeof(double));
+   top = malloc(k*sizeof(double));
+   Check_for_error(local_x != NULL && local_y != NULL && local_z != NULL
+         && top != NULL, "main", "Can't allocate local vector(s)", comm);
+
+   srand(time(NULL) + my_rank);
+   for (local_i = 0; local_i < local_n; local_i++) {
+      local_x[local_i] = 100.0*rand()/RAND_MAX;
+      local_y[local_i] = 100.0*rand()/RAND_MAX;
+   }
+   Parallel_vector_sum(local_x, local_y, local_z, local_n);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   top_n = Parallel_top_k(local_z, local_n, k, top, my_rank, comm_sz,
+         comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   bucket_n = Parallel_sample_sort(local_z, local_n, &bucket, my_rank,
+         comm_sz, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   sorted = Gather_and_qsort(local_z, local_n, n, my_rank, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[2], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   ok = Check_sample_sort(bucket, bucket_n, sorted, n, my_rank, comm_sz,
+         comm);
+   if (my_rank == 0) {
+      for (i = 0; i < top_n; i++)
+         if (top[i] != sorted[n-1-i]) ok = 0;
+      printf("n = %d, k = %d, comm_sz = %d\n", n, k, comm_sz);
+      printf("Top %d of z:\n", top_n);
+      for (i = 0; i < top_n; i++)
+         printf("%f ", top[i]);
+      printf("\n");
+      printf("Distributed top-k:    %f ms\n", elapsed[0]*1000);
+      printf("Sample sort:          %f ms\n", elapsed[1]*1000);
+      printf("Gather and qsort:     %f ms\n", elapsed[2]*1000);
+      printf("Results %s\n", ok ? "agree" : "DIFFER");
+   }
+
+   free(local_x);
+   free(local_y);
+   free(local_z);
+   free(top);
+   free(bucket);
+   free(sorted);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors and k from the command line
+ * In args:   argc, argv:  command line
+ *            comm_sz, comm:  usual MPI values
+ * Out args:  n_p:  order of the vectors
+ *            k_p:  number of largest elements to find
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            and 1 <= k <= n
+ */
+void Get_args(
+      int       argc     /* in  */,
+      char*     argv[]   /* in  */,
+      int*      n_p      /* out */,
+      int*      k_p      /* out */,
+      int       comm_sz  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int local_ok = 1;
+
+   *n_p = 10000000;
+   *k_p = 10;
+   if (argc > 1) *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *k_p = strtol(argv[2], NULL, 10);
+
+   if (*n_p <= 0 || *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*k_p < 1 || *k_p > *n_p) local_ok = 0;
+   Check_for_error(local_ok, "Get_args", "k should be in [1, n]", comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Radix_sort
+ * Purpose:   Sort an array of doubles in increasing order
+ * In args:   n:    number of elements
+ * In/out:    a:    the array
+ * Scratch:   tmp:  n doubles of work space
+ *
+ * Note:      The bits of each double are mapped to an unsigned key
+ *            with the same order (flip all bits of negatives, the
+ *            sign bit of the others), and the keys are sorted 8 bits
+ *            at a time, least significant byte first.  Passes in
+ *            which every key has the same byte are skipped.  NaNs
+ *            are not supported.
+ */
+void Radix_sort(
+      double  a[]    /* in/out  */,
+      double  tmp[]  /* scratch */,
+      int     n      /* in      */) {
+   uint64_t* keys = (uint64_t*) a;
+   uint64_t* work = (uint64_t*) tmp;
+   uint64_t* t;
+   uint64_t key;
+   int count[8][256];
+   int i, pass, b, sum, c;
+
+   /* One sweep computes the byte histograms of all the passes */
+   memset(count, 0, sizeof(count));
+   for (i = 0; i < n; i++) {
+      key = keys[i];
+      key ^= (key >> 63) ? ~(uint64_t) 0 : (uint64_t) 1 << 63;
+      keys[i] = key;
+      for (pass = 0; pass < 8; pass++)
+         count[pass][(key >> (8*pass)) & 0xff]++;
+   }
+
+   for (pass = 0; pass < 8; pass++) {
+      if (n == 0 || count[pass][(keys[0] >> (8*pass)) & 0xff] == n)
+         continue;
+      sum = 0;
+      for (b = 0; b < 256; b++) {
+         c = count[pass][b];
+         count[pass][b] = sum;
+         sum += c;
+      }
+      for (i = 0; i < n; i++)
+         work[count[pass][(keys[i] >> (8*pass)) & 0xff]++] = keys[i];
+      t = keys; keys = work; work = t;
+   }
+
+   for (i = 0; i < n; i++) {
+      key = keys[i];
+      key ^= (key >> 63) ? (uint64_t) 1 << 63 : ~(uint64_t) 0;
+      ((uint64_t*) a)[i] = key;
+   }
+}  /* Radix_sort */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Heap_sift_down
+ * Purpose:   Restore the min-heap property below position i
+ * In args:   size:  number of elements in the heap
+ *            i:     position of the element that may be too large
+ * In/out:    heap
+ */
+void Heap_sift_down(
+      double  heap[]  /* in/out */,
+      int     size    /* in     */,
+      int     i       /* in     */) {
+   int child;
+   double x = heap[i];
+
+   while ((child = 2*i + 1) < size) {
+      if (child + 1 < size && heap[child+1] < heap[child]) child++;
+      if (heap[child] >= x) break;
+      heap[i] = heap[child];
+      i = child;
+   }
+   heap[i] = x;
+}  /* Heap_sift_down */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Local_top_k
+ * Purpose:   Find the k largest elements of an array
+ * In args:   local_a, local_n:  the array
+ *            k:                 number of elements wanted
+ * Out arg:   top:  the min(k, local_n) largest elements, in
+ *                  decreasing order
+ * Ret val:   min(k, local_n)
+ */
+int Local_top_k(
+      double  local_a[]  /* in  */,
+      int     local_n    /* in  */,
+      int     k          /* in  */,
+      double  top[]      /* out */) {
+   int local_i, size = k < local_n ? k : local_n, last;
+   double x;
+
+   /* top[0] is the smallest of the k largest seen so far */
+   memcpy(top, local_a, size*sizeof(double));
+   for (local_i = size/2 - 1; local_i >= 0; local_i--)
+      Heap_sift_down(top, size, local_i);
+   for (local_i = size; local_i < local_n; local_i++)
+      if (local_a[local_i] > top[0]) {
+         top[0] = local_a[local_i];
+         Heap_sift_down(top, size, 0);
+      }
+
+   /* Heap sort the heap into decreasing order */
+   for (last = size - 1; last > 0; last--) {
+      x = top[0]; top[0] = top[last]; top[last] = x;
+      Heap_sift_down(top, last, 0);
+   }
+   return size;
+}  /* Local_top_k */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Merge_top_k
+ * Purpose:   Merge two lists sorted in decreasing order, keeping the
+ *            k largest elements
+ * In args:   a, a_n, b, b_n:  the lists
+ *            k:               maximum length of the result
+ * Out arg:   c:  the merged list
+ * Ret val:   Length of c
+ */
+int Merge_top_k(
+      double  a[]  /* in  */,
+      int     a_n  /* in  */,
+      double  b[]  /* in  */,
+      int     b_n  /* in  */,
+      int     k    /* in  */,
+      double  c[]  /* out */) {
+   int i = 0, j = 0, m = 0;
+
+   while (m < k && (i < a_n || j < b_n))
+      if (j == b_n || (i < a_n && a[i] >= b[j]))
+         c[m++] = a[i++];
+      else
+         c[m++] = b[j++];
+   return m;
+}  /* Merge_top_k */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_top_k
+ * Purpose:   Find the k largest elements of a block distributed
+ *            vector.  The local lists are merged along a binary tree:
+ *            at each stage the processes whose rank is an odd
+ *            multiple of the stride send their list to rank - stride.
+ * In args:   local_a, local_n:  local block of the vector
+ *            k:                 number of elements wanted
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Out arg:   top:  on process 0 the min(k, n) largest elements in
+ *                  decreasing order.  Needs room for k elements.
+ * Ret val:   Number of elements in top on process 0
+ */
+int Parallel_top_k(
+      double    local_a[]  /* in  */,
+      int       local_n    /* in  */,
+      int       k          /* in  */,
+      double    top[]      /* out */,
+      int       my_rank    /* in  */,
+      int       comm_sz    /* in  */,
+      MPI_Comm  comm       /* in  */) {
+   int top_n, recv_n, stride, local_ok = 1;
+   double *recv_buf, *merge_buf;
+
+   recv_buf = malloc(k*sizeof(double));
+   merge_buf = malloc(k*sizeof(double));
+   if (recv_buf == NULL || merge_buf == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Parallel_top_k",
+         "Can't allocate merge buffers", comm);
+
+   top_n = Local_top_k(local_a, local_n, k, top);
+
+   for (stride = 1; stride < comm_sz; stride *= 2) {
+      if (my_rank % (2*stride) == stride) {
+         MPI_Send(top, top_n, MPI_DOUBLE, my_rank - stride, 0, comm);
+         break;
+      } else if (my_rank % (2*stride) == 0 && my_rank + stride < comm_sz) {
+         MPI_Status status;
+         MPI_Recv(recv_buf, k, MPI_DOUBLE, my_rank + stride, 0, comm,
+               &status);
+         MPI_Get_count(&status, MPI_DOUBLE, &recv_n);
+         top_n = Merge_top_k(top, top_n, recv_buf, recv_n, k, merge_buf);
+         memcpy(top, merge_buf, top_n*sizeof(double));
+      }
+   }
+
+   free(recv_buf);
+   free(merge_buf);
+   return top_n;
+}  /* Parallel_top_k */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_sample_sort
+ * Purpose:   Sort a block distributed vector so that process q ends
+ *            up with the q-th range of values, in increasing order
+ * In args:   local_a, local_n:  local block of the vector.  local_a
+ *                               is left unchanged.
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Out arg:   bucket_pp:  newly allocated array with the process's
+ *                        sorted range.  The caller frees it.
+ * Ret val:   Number of elements in the bucket
+ *
+ * Note:      Splitters are chosen from comm_sz-1 regularly spaced
+ *            samples of every sorted block, which bounds every
+ *            bucket by about 2n/comm_sz elements.
+ */
+int Parallel_sample_sort(
+      double    local_a[]   /* in  */,
+      int       local_n     /* in  */,
+      double**  bucket_pp   /* out */,
+      int       my_rank     /* in  */,
+      int       comm_sz     /* in  */,
+      MPI_Comm  comm        /* in  */) {
+   double *sorted, *tmp, *samples, *all_samples, *splitters, *bucket;
+   int *send_counts, *send_displs, *recv_counts, *recv_displs;
+   int q, lo, hi, mid, bucket_n, local_ok = 1;
+   int tmp_n = local_n > comm_sz*comm_sz ? local_n : comm_sz*comm_sz;
+
+   sorted = malloc(local_n*sizeof(double));
+   tmp = malloc(tmp_n*sizeof(double));
+   samples = malloc(comm_sz*sizeof(double));
+   all_samples = malloc(comm_sz*comm_sz*sizeof(double));
+   splitters = malloc(comm_sz*sizeof(double));
+   send_counts = malloc(4*comm_sz*sizeof(int));
+   if (sorted == NULL || tmp == NULL || samples == NULL ||
+         all_samples == NULL || splitters == NULL || send_counts == NULL)
+      local_ok = 0;
+   Check_for_error(local_ok, "Parallel_sample_sort",
+         "Can't allocate work space", comm);
+   send_displs = send_counts + comm_sz;
+   recv_counts = send_counts + 2*comm_sz;
+   recv_displs = send_counts + 3*comm_sz;
+
+   memcpy(sorted, local_a, local_n*sizeof(double));
+   Radix_sort(sorted, tmp, local_n);
+
+   /* Regular samples -> splitters */
+   for (q = 1; q < comm_sz; q++)
+      samples[q-1] = sorted[(long) q*local_n/comm_sz];
+   MPI_Allgather(samples, comm_sz - 1, MPI_DOUBLE, all_samples,
+         comm_sz - 1, MPI_DOUBLE, comm);
+   Radix_sort(all_samples, tmp, comm_sz*(comm_sz - 1));
+   for (q = 1; q < comm_sz; q++)
+      splitters[q-1] = all_samples[q*(comm_sz - 1) - 1 + q/2];
+
+   /* Process q gets the elements in (splitters[q-1], splitters[q]] */
+   lo = 0;
+   for (q = 0; q < comm_sz; q++) {
+      if (q == comm_sz - 1) {
+         hi = local_n;
+      } else {
+         int first = lo, last = local_n;
+         while (first < last) {
+            mid = first + (last - first)/2;
+            if (sorted[mid] <= splitters[q]) first = mid + 1;
+            else last = mid;
+         }
+         hi = first;
+      }
+      send_displs[q] = lo;
+      send_counts[q] = hi - lo;
+      lo = hi;
+   }
+
+   MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+   bucket_n = 0;
+   for (q = 0; q < comm_sz; q++) {
+      recv_displs[q] = bucket_n;
+      bucket_n += recv_counts[q];
+   }
+
+   bucket = malloc((bucket_n + 1)*sizeof(double));
+   if (bucket == NULL || (bucket_n > tmp_n &&
+            (tmp = realloc(tmp, bucket_n*sizeof(double))) == NULL))
+      local_ok = 0;
+   Check_for_error(local_ok, "Parallel_sample_sort",
+         "Can't allocate bucket", comm);
+   MPI_Alltoallv(sorted, send_counts, send_displs, MPI_DOUBLE, bucket,
+         recv_counts, recv_displs, MPI_DOUBLE, comm);
+
+   /* The bucket is comm_sz sorted runs:  one more radix sort */
+   Radix_sort(bucket, tmp, bucket_n);
+
+   free(sorted);
+   free(tmp);
+   free(samples);
+   free(all_samples);
+   free(splitters);
+   free(send_counts);
+   *bucket_pp = bucket;
+   return bucket_n;
+}  /* Parallel_sample_sort */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Gather_and_qsort
+ * Purpose:   Gather a block distributed vector to process 0 and sort
+ *            it with qsort:  the reference for the distributed
+ *            versions.
+ * In args:   local_a, local_n:  local block of the vector
+ *            n:                 order of the vector
+ *            my_rank, comm:     usual MPI values
+ * Ret val:   On process 0 the sorted vector (to be freed by the
+ *            caller), NULL on the other processes
+ */
+double* Gather_and_qsort(
+      double    local_a[]  /* in */,
+      int       local_n    /* in */,
+      int       n          /* in */,
+      int       my_rank    /* in */,
+      MPI_Comm  comm       /* in */) {
+   double* a = NULL;
+   int local_ok = 1;
+
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "Gather_and_qsort",
+         "Can't allocate temporary vector", comm);
+   MPI_Gather(local_a, local_n, MPI_DOUBLE, a, local_n, MPI_DOUBLE, 0,
+         comm);
+   if (my_rank == 0)
+      qsort(a, n, sizeof(double), Compare_double);
+   return a;
+}  /* Gather_and_qsort */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compare_double
+ * Purpose:   qsort comparison function for increasing order
+ */
+int Compare_double(const void* a_p, const void* b_p) {
+   double a = *(const double*) a_p;
+   double b = *(const double*) b_p;
+
+   return (a > b) - (a < b);
+}  /* Compare_double */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Check_sample_sort
+ * Purpose:   Gather the buckets of the sample sort to process 0 and
+ *            compare them with the gathered and qsorted vector
+ * In args:   bucket, bucket_n:  this process' bucket
+ *            sorted:  on process 0 the reference sorted vector
+ *            n:       order of the vector
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Ret val:   On process 0, 1 if the results agree and 0 otherwise
+ */
+int Check_sample_sort(
+      double    bucket[]    /* in */,
+      int       bucket_n    /* in */,
+      double    sorted[]    /* in */,
+      int       n           /* in */,
+      int       my_rank     /* in */,
+      int       comm_sz     /* in */,
+      MPI_Comm  comm        /* in */) {
+   double* all = NULL;
+   int *counts = NULL, *displs = NULL;
+   int q, ok = 1, local_ok = 1;
+
+   if (my_rank == 0) {
+      all = malloc(n*sizeof(double));
+      counts = malloc(2*comm_sz*sizeof(int));
+      if (all == NULL || counts == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "Check_sample_sort",
+         "Can't allocate temporary vector", comm);
+   MPI_Gather(&bucket_n, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+   if (my_rank == 0) {
+      displs = counts + comm_sz;
+      displs[0] = 0;
+      for (q = 1; q < comm_sz; q++)
+         displs[q] = displs[q-1] + counts[q-1];
+      if (displs[comm_sz-1] + counts[comm_sz-1] != n) ok = 0;
+   }
+   MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+   if (ok) {
+      MPI_Gatherv(bucket, bucket_n, MPI_DOUBLE, all, counts, displs,
+            MPI_DOUBLE, 0, comm);
+      if (my_rank == 0)
+         ok = memcmp(all, sorted, n*sizeof(double)) == 0;
+   }
+   free(all);
+   free(counts);
+   return ok;
+}  /* Check_sample_sort */
@@ -0,0 +1,611 @@
+/* File:     mpi_vector_stats.c
+ *
+ * Purpose:  Compute summary statistics of a block distributed vector
+ *           without gathering it:
+ *
+ *           - count, min, max, mean and variance:  each process runs
+ *             Welford's update over its block and the partial results
+ *             are merged (Chan et al.) by a user defined MPI_Op;
+ *           - a histogram with fixed bins, combined with
+ *             MPI_Allreduce;
+ *           - quantiles from a mergeable compactor sketch in the
+ *             style of KLL:  every level holds at most k items, and a
+ *             full level is sorted and every other item (starting at
+ *             a random offset) is promoted to the next level with
+ *             twice the weight.  The sketches of the processes are
+ *             gathered to process 0 and merged.
+ *
+ *           All three are updated in the same single pass over each
+ *           process's block.  Process 0 then gathers the vector and
+ *           computes the exact values to check them.
+ *
+ * Compile:  mpicc -O3 -Wall -o mpi_vector_stats mpi_vector_stats.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_stats [<n> [<bins> [<k>]]]
+ *
+ * Input:    Optional command line args: the order of the vector n
+ *           (default 10000000), the number of histogram bins
+ *           (default 10) and the capacity k of the sketch levels
+ *           (default 200)
+ * Output:   The statistics, the histogram, some quantiles with their
+ *           rank error, and the run times of the one-pass summary
+ *           and of the gathered exact computation.
+ *
+ * Notes:
+ * 1.  The order of the vector, n, should be evenly divisible
+ *     by comm_sz
+ * 2.  The vector is z = x + y with x and y uniform on [0, 100), so
+ *     the histogram covers [0, 200).  Values outside the range are
+ *     counted in an underflow and an overflow bin.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+
+#define MAX_LEVELS 48
+
+typedef struct {
+   double  count;
+   double  mean;
+   double  m2;     /* sum of squared deviations from the mean */
+   double  min;
+   double  max;
+} moments_t;
+
+typedef struct {
+   int      k;                     /* capacity of each level      */
+   int      levels;                /* number of levels in use     */
+   int      size[MAX_LEVELS];      /* items in each level         */
+   int      alloc[MAX_LEVELS];     /* allocated items per level   */
+   double*  item[MAX_LEVELS];      /* item[h] has weight 2^h      */
+} sketch_t;
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* bins_p, int* k_p,
+      int comm_sz, MPI_Comm comm);
+void Moments_merge(moments_t* a_p, moments_t* b_p);
+void Moments_op_fn(void* in, void* inout, int* len, MPI_Datatype* type);
+void Sketch_init(sketch_t* s_p, int k);
+void Sketch_free(sketch_t* s_p);
+void Sketch_push(sketch_t* s_p, int h, double x);
+void Sketch_compact(sketch_t* s_p, int h);
+void Sketch_insert(sketch_t* s_p, double x);
+void Sketch_merge(sketch_t* dst_p, sketch_t* src_p);
+double Sketch_quantile(sketch_t* s_p, double q);
+void Parallel_summary(double local_a[], int local_n, double lo, double hi,
+      int bins, int k, long hist[], moments_t* mom_p, sketch_t* s_p,
+      MPI_Datatype moments_type, MPI_Op moments_op, int my_rank,
+      int comm_sz, MPI_Comm comm);
+int Compare_double(const void* a_p, const void* b_p);
+
+
+/*-------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, bins, k, local_n, local_i, i, b, qi;
+   int comm_sz, my_rank, local_ok = 1;
+   double *local_a, *a = NULL, lo = 0.0, hi = 200.0;
+   double q[] = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+   double est, exact_mean = 0.0, exact_m2 = 0.0;
+   long* hist;
+   moments_t mom;
+   sketch_t sketch;
+   double start, finish, loc_elapsed, elapsed[2];
+   MPI_Datatype moments_type;
+   MPI_Op moments_op;
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &bins, &k, comm_sz, comm);
+   local_n = n/comm_sz;
+
+   local_a = malloc(local_n*sizeof(double));
+   hist = malloc((bins + 2)*sizeof(long));
+   Check_for_error(local_a != NULL && hist != NULL, "main",
+         "Can't allocate local storage", comm);
+
+   srand(time(NULL) + my_rank);
+   for (local_i = 0; local_i < local_n; local_i++)
+      local_a[local_i] = 100.0*rand()/RAND_MAX + 100.0*rand()/RAND_MAX;
+
+   MPI_Type_contiguous(5, MPI_DOUBLE, &moments_type);
+   MPI_Type_commit(&moments_type);
+   MPI_Op_create(Moments_op_fn, 1, &moments_op);
+
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   Parallel_summary(local_a, local_n, lo, hi, bins, k, hist, &mom,
+         &sketch, moments_type, moments_op, my_rank, comm_sz, comm);
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[0], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   /* Exact values on process 0 */
+   MPI_Barrier(comm);
+   start = MPI_Wtime();
+   if (my_rank == 0) {
+      a = malloc(n*sizeof(double));
+      if (a == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "main", "Can't allocate temporary vector",
+         comm);
+   MPI_Gather(local_a, local_n, MPI_DOUBLE, a, local_n, MPI_DOUBLE, 0,
+         comm);
+   if (my_rank == 0) {
+      for (i = 0; i < n; i++) exact_mean += a[i];
+      exact_mean /= n;
+      for (i = 0; i < n; i++)
+         exact_m2 += (a[i] - exact_mean)*(a[i] - exact_mean);
+      qsort(a, n, sizeof(double), Compare_double);
+   }
+   finish = MPI_Wtime();
+   loc_elapsed = finish-start;
+   MPI_Reduce(&loc_elapsed, &elapsed[1], 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+   if (my_rank == 0) {
+      printf("n = %d, comm_sz = %d\n", n, comm_sz);
+      printf("min = %f, max = %f\n", mom.min, mom.max);
+      printf("mean = %.10f (exact %.10f)\n", mom.mean, exact_mean);
+      printf("variance = %.10f (exact %.10f)\n", mom.m2/mom.count,
+            exact_m2/n);
+      printf("Histogram of [%g, %g):\n", lo, hi);
+      printf("   underflow: %ld\n", hist[0]);
+      for (b = 0; b < bins; b++)
+         printf("   [%8.3f, %8.3f): %ld\n", lo + b*(hi - lo)/bins,
+               lo + (b + 1)*(hi - lo)/bins, hist[b+1]);
+      printf("   overflow:  %ld\n", hist[bins+1]);
+      printf("Quantiles (sketch with k = %d):\n", k);
+      for (qi = 0; qi < sizeof(q)/sizeof(q[0]); qi++) {
+         long lo_rank = 0, hi_rank = n;
+         est = Sketch_quantile(&sketch, q[qi]);
+         /* rank of est in the sorted vector */
+         while (lo_rank < hi_rank) {
+            long mid = (lo_rank + hi_rank)/2;
+            if (a[mid] < est) lo_rank = mid + 1;
+            else hi_rank = mid;
+         }
+         printf("   q = %4.2f: %f (exact %f, rank error %.4f)\n", q[qi],
+               est, a[(long) (q[qi]*(n - 1))],
+               fabs((double) lo_rank/n - q[qi]));
+      }
+      printf("One-pass summary:     %f ms\n", elapsed[0]*1000);
+      printf("Gather and compute:   %f ms\n", elapsed[1]*1000);
+   }
+
+   MPI_Op_free(&moments_op);
+   MPI_Type_free(&moments_type);
+   Sketch_free(&sketch);
+   free(local_a);
+   free(hist);
+   free(a);
+
+   MPI_Finalize();
+
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vector, the number of bins and the
+ *            sketch capacity from the command line
+ * In args:   argc, argv:  command line
+ *            comm_sz, comm:  usual MPI values
+ * Out args:  n_p:     order of the vector
+ *            bins_p:  number of histogram bins
+ *            k_p:     capacity of each sketch level
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            bins should be positive and k at least 2
+ */
+void Get_args(
+      int       argc     /* in  */,
+      char*     argv[]   /* in  */,
+      int*      n_p      /* out */,
+      int*      bins_p   /* out */,
+      int*      k_p      /* out */,
+      int       comm_sz  /* in  */,
+      MPI_Comm  comm     /* in  */) {
+   int local_ok = 1;
+
+   *n_p = 10000000;
+   *bins_p = 10;
+   *k_p = 200;
+   if (argc > 1) *n_p = strtol(argv[1], NULL, 10);
+   if (argc > 2) *bins_p = strtol(argv[2], NULL, 10);
+   if (argc > 3) *k_p = strtol(argv[3], NULL, 10);
+
+   if (*n_p <= 0 || *n_p % comm_sz != 0) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   if (*bins_p < 1 || *k_p < 2) local_ok = 0;
+   Check_for_error(local_ok, "Get_args",
+         "bins should be > 0 and k should be > 1", comm);
+}  /* Get_args */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Moments_merge
+ * Purpose:   Combine the moments of two disjoint sets of values
+ * In arg:    a_p:  moments of the first set
+ * In/out:    b_p:  on input moments of the second set, on output
+ *                  moments of the union
+ */
+void Moments_merge(
+      moments_t*  a_p  /* in     */,
+      moments_t*  b_p  /* in/out */) {
+   double count, delta;
+
+   if (a_p->count == 0.0) return;
+   if (b_p->count == 0.0) {
+      *b_p = *a_p;
+      return;
+   }
+   count = a_p->count + b_p->count;
+   delta = b_p->mean - a_p->mean;
+   b_p->mean = a_p->mean + delta*b_p->count/count;
+   b_p->m2 += a_p->m2 + delta*delta*a_p->count*b_p->count/count;
+   b_p->count = count;
+   if (a_p->min < b_p->min) b_p->min = a_p->min;
+   if (a_p->max > b_p->max) b_p->max = a_p->max;
+}  /* Moments_merge */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Moments_op_fn
+ * Purpose:   MPI_User_function merging arrays of moments_t
+ */
+void Moments_op_fn(
+      void*          in     /* in     */,
+      void*          inout  /* in/out */,
+      int*           len    /* in     */,
+      MPI_Datatype*  type   /* in     */) {
+   moments_t* a = in;
+   moments_t* b = inout;
+   int i;
+
+   for (i = 0; i < *len; i++)
+      Moments_merge(&a[i], &b[i]);
+}  /* Moments_op_fn */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_init
+ * Purpose:   Initialize an empty sketch
+ * In arg:    k:    capacity of each level
+ * Out arg:   s_p:  the sketch
+ */
+void Sketch_init(
+      sketch_t*  s_p  /* out */,
+      int        k    /* in  */) {
+   memset(s_p, 0, sizeof(sketch_t));
+   s_p->k = k;
+}  /* Sketch_init */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_free
+ * Purpose:   Free the storage of a sketch
+ * In/out:    s_p
+ */
+void Sketch_free(sketch_t* s_p  /* in/out */) {
+   int h;
+
+   for (h = 0; h < s_p->levels; h++)
+      free(s_p->item[h]);
+   memset(s_p, 0, sizeof(sketch_t));
+}  /* Sketch_free */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_push
+ * Purpose:   Append an item to a level of a sketch, without
+ *            compacting
+ * In args:   h:    the level
+ *            x:    the item
+ * In/out:    s_p:  the sketch
+ *
+ * Errors:    If the level can't be grown the program terminates
+ */
+void Sketch_push(
+      sketch_t*  s_p  /* in/out */,
+      int        h    /* in     */,
+      double     x    /* in     */) {
+   if (h >= MAX_LEVELS) {
+      fprintf(stderr, "Sketch_push: too many levels\n");
+      MPI_Abort(MPI_COMM_WORLD, -1);
+   }
+   while (s_p->levels <= h) s_p->levels++;
+   if (s_p->size[h] == s_p->alloc[h]) {
+      s_p->alloc[h] = s_p->alloc[h] ? 2*s_p->alloc[h] : s_p->k;
+      s_p->item[h] = realloc(s_p->item[h], s_p->alloc[h]*sizeof(double));
+      if (s_p->item[h] == NULL) {
+         fprintf(stderr, "Sketch_push: can't grow level %d\n", h);
+         MPI_Abort(MPI_COMM_WORLD, -1);
+      }
+   }
+   s_p->item[h][s_p->size[h]++] = x;
+}  /* Sketch_push */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_compact
+ * Purpose:   Halve a full level:  sort it and promote every other
+ *            item, starting at a random offset, to the next level.
+ *            An odd item out stays in the level.
+ * In arg:    h:    the level
+ * In/out:    s_p:  the sketch
+ */
+void Sketch_compact(
+      sketch_t*  s_p  /* in/out */,
+      int        h    /* in     */) {
+   int i, m = s_p->size[h] & ~1;
+   double* item = s_p->item[h];
+
+   qsort(item, s_p->size[h], sizeof(double), Compare_double);
+   for (i = rand() & 1; i < m; i += 2)
+      Sketch_push(s_p, h + 1, item[i]);
+   /* item may have moved if h+1 was allocated:  reload it */
+   item = s_p->item[h];
+   if (s_p->size[h] > m) item[0] = item[m];
+   s_p->size[h] -= m;
+   if (s_p->size[h+1] >= s_p->k) Sketch_compact(s_p, h + 1);
+}  /* Sketch_compact */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_insert
+ * Purpose:   Add a value to a sketch
+ * In arg:    x:    the value
+ * In/out:    s_p:  the sketch
+ */
+void Sketch_insert(
+      sketch_t*  s_p  /* in/out */,
+      double     x    /* in     */) {
+   Sketch_push(s_p, 0, x);
+   if (s_p->size[0] >= s_p->k) Sketch_compact(s_p, 0);
+}  /* Sketch_insert */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_merge
+ * Purpose:   Add the items of one sketch to another
+ * In arg:    src_p:  the sketch to add.  Must have the same k.
+ * In/out:    dst_p:  the sketch that receives the items
+ */
+void Sketch_merge(
+      sketch_t*  dst_p  /* in/out */,
+      sketch_t*  src_p  /* in     */) {
+   int h, i;
+
+   for (h = 0; h < src_p->levels; h++)
+      for (i = 0; i < src_p->size[h]; i++)
+         Sketch_push(dst_p, h, src_p->item[h][i]);
+   for (h = 0; h < dst_p->levels; h++)
+      if (dst_p->size[h] >= dst_p->k) Sketch_compact(dst_p, h);
+}  /* Sketch_merge */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Sketch_quantile
+ * Purpose:   Estimate a quantile from a sketch
+ * In args:   s_p:  the sketch
+ *            q:    the quantile, in [0, 1]
+ * Ret val:   The smallest item whose cumulative weight reaches q
+ *            times the total weight
+ */
+double Sketch_quantile(
+      sketch_t*  s_p  /* in */,
+      double     q    /* in */) {
+   int h, i, m = 0;
+   double *pairs, total = 0.0, cum = 0.0, result;
+
+   for (h = 0; h < s_p->levels; h++) m += s_p->size[h];
+   if (m == 0) return NAN;
+   pairs = malloc(2*m*sizeof(double));
+   if (pairs == NULL) {
+      fprintf(stderr, "Sketch_quantile: can't allocate pairs\n");
+      MPI_Abort(MPI_COMM_WORLD, -1);
+   }
+
+   /* (value, weight) pairs sorted on the value */
+   m = 0;
+   for (h = 0; h < s_p->levels; h++)
+      for (i = 0; i < s_p->size[h]; i++) {
+         pairs[2*m] = s_p->item[h][i];
+         pairs[2*m+1] = ldexp(1.0, h);
+         total += pairs[2*m+1];
+         m++;
+      }
+   qsort(pairs, m, 2*sizeof(double), Compare_double);
+
+   result = pairs[2*(m-1)];
+   for (i = 0; i < m; i++) {
+      cum += pairs[2*i+1];
+      if (cum >= q*total) {
+         result = pairs[2*i];
+         break;
+      }
+   }
+
+   free(pairs);
+   return result;
+}  /* Sketch_quantile */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Parallel_summary
+ * Purpose:   Compute the moments, histogram and quantile sketch of a
+ *            block distributed vector in one pass over each block
+ * In args:   local_a, local_n:  local block of the vector
+ *            lo, hi, bins:      histogram range and number of bins
+ *            k:                 capacity of each sketch level
+ *            moments_type, moments_op:  MPI datatype and operator
+ *                               for moments_t
+ *            my_rank, comm_sz, comm:  usual MPI values
+ * Out args:  hist:   bins+2 counts on every process:  hist[0] is the
+ *                    underflow, hist[bins+1] the overflow
+ *            mom_p:  moments of the vector on every process
+ *            s_p:    on process 0 the merged sketch, on the other
+ *                    processes the local sketch
+ */
+void Parallel_summary(
+      double        local_a[]     /* in  */,
+      int           local_n       /* in  */,
+      double        lo            /* in  */,
+      double        hi            /* in  */,
+      int           bins          /* in  */,
+      int           k             /* in  */,
+      long          hist[]        /* out */,
+      moments_t*    mom_p         /* out */,
+      sketch_t*     s_p           /* out */,
+      MPI_Datatype  moments_type  /* in  */,
+      MPI_Op        moments_op    /* in  */,
+      int           my_rank       /* in  */,
+      int           comm_sz       /* in  */,
+      MPI_Comm      comm          /* in  */) {
+   int local_i, b, h, q, i, len, local_ok = 1;
+   int *lens = NULL, *displs = NULL;
+   double x, delta, scale = bins/(hi - lo);
+   double *buf, *all = NULL;
+   moments_t local_mom = {0.0, 0.0, 0.0, INFINITY, -INFINITY};
+   long* local_hist = calloc(bins + 2, sizeof(long));
+   sketch_t other;
+
+   Check_for_error(local_hist != NULL, "Parallel_summary",
+         "Can't allocate local histogram", comm);
+   Sketch_init(s_p, k);
+
+   /* The single pass */
+   for (local_i = 0; local_i < local_n; local_i++) {
+      x = local_a[local_i];
+
+      local_mom.count += 1.0;
+      delta = x - local_mom.mean;
+      local_mom.mean += delta/local_mom.count;
+      local_mom.m2 += delta*(x - local_mom.mean);
+      if (x < local_mom.min) local_mom.min = x;
+      if (x > local_mom.max) local_mom.max = x;
+
+      if (x < lo) b = 0;
+      else if (x >= hi) b = bins + 1;
+      else {
+         b = (int) ((x - lo)*scale) + 1;
+         if (b > bins) b = bins;
+      }
+      local_hist[b]++;
+
+      Sketch_insert(s_p, x);
+   }
+
+   MPI_Allreduce(&local_mom, mom_p, 1, moments_type, moments_op, comm);
+   MPI_Allreduce(local_hist, hist, bins + 2, MPI_LONG, MPI_SUM, comm);
+
+   /* Serialize the sketch as [levels, size[0..levels-1], items...] */
+   len = 1 + s_p->levels;
+   for (h = 0; h < s_p->levels; h++) len += s_p->size[h];
+   buf = malloc(len*sizeof(double));
+   if (buf == NULL) local_ok = 0;
+   if (my_rank == 0) {
+      lens = malloc(2*comm_sz*sizeof(int));
+      if (lens == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "Parallel_summary",
+         "Can't allocate sketch buffers", comm);
+   buf[0] = s_p->levels;
+   i = 1 + s_p->levels;
+   for (h = 0; h < s_p->levels; h++) {
+      buf[1+h] = s_p->size[h];
+      memcpy(buf + i, s_p->item[h], s_p->size[h]*sizeof(double));
+      i += s_p->size[h];
+   }
+
+   MPI_Gather(&len, 1, MPI_INT, lens, 1, MPI_INT, 0, comm);
+   if (my_rank == 0) {
+      displs = lens + comm_sz;
+      displs[0] = 0;
+      for (q = 1; q < comm_sz; q++) displs[q] = displs[q-1] + lens[q-1];
+      all = malloc((displs[comm_sz-1] + lens[comm_sz-1])*sizeof(double));
+      if (all == NULL) local_ok = 0;
+   }
+   Check_for_error(local_ok, "Parallel_summary",
+         "Can't allocate sketch buffers", comm);
+   MPI_Gatherv(buf, len, MPI_DOUBLE, all, lens, displs, MPI_DOUBLE, 0,
+         comm);
+
+   if (my_rank == 0) {
+      for (q = 1; q < comm_sz; q++) {
+         double* p = all + displs[q];
+         Sketch_init(&other, s_p->k);
+         other.levels = (int) p[0];
+         i = 1 + other.levels;
+         for (h = 0; h < other.levels; h++) {
+            /* Borrow the storage in all:  nothing is pushed to other */
+            other.size[h] = other.alloc[h] = (int) p[1+h];
+            other.item[h] = p + i;
+            i += other.size[h];
+         }
+         Sketch_merge(s_p, &other);
+      }
+   }
+
+   free(local_hist);
+   free(buf);
+   free(lens);
+   free(all);
+}  /* Parallel_summary */
+
+
+/*-------------------------------------------------------------------
+ * Function:  Compare_double
+ * Purpose:   qsort comparison function for increasing order.  Only
+ *            the first double of each element is compared, so it
+ *            also sorts the (value, weight) pairs of Sketch_quantile.
+ */
+int Compare_double(const void* a_p, const void* b_p) {
+   double a = *(const double*) a_p;
+   double b = *(const double*) b_p;
+
+   return (a > b) - (a < b);
+}  /* Compare_double */
@@ -0,0 +1,429 @@
+/* File:     mpi_vector_stream.c
+ *
+ * Purpose:  STREAM-compatible memory bandwidth benchmark built from the
+ *           lab's vector kernels:
+ *
+ *              Copy:   c = a             (Vector_copy)
+ *              Scale:  b = scalar*c      (Vector_scale)
+ *              Add:    c = a + b         (Vector_sum)
+ *              Triad:  a = b + scalar*c  (Vector_triad)
+ *
+ *           The kernels are run over two paths:  the threaded path
+ *           runs the whole vectors on process 0 with OpenMP threads,
+ *           and the MPI path distributes them by blocks over all the
+ *           processes, each of which also uses its threads.  Each path
+ *           prints STREAM's table, so the rates can be compared with
+ *           published STREAM results.
+ *
+ * Compile:  mpicc -O3 -Wall [-fopenmp] -o mpi_vector_stream \
+ *              mpi_vector_stream.c lab3_kernels.c -lm
+ * Run:      mpiexec -n <comm_sz> ./mpi_vector_stream [-n <n>]
+ *                 [-t <thread_count>] [-k <ntimes>]
+ *
+ * Input:    None
+ * Output:   For each path, the best rate (MB/s, 10^6 bytes) and the
+ *           average, minimum and maximum times of each kernel, and
+ *           whether the results validate
+ *
+ * Notes:
+ * 1.  The STREAM rules followed:  each kernel is run ntimes (default
+ *     10) times in the order above, and the first iteration is
+ *     dropped from the statistics; the best rate comes from the
+ *     minimum time; Copy and Scale move 2*n doubles and Add and Triad
+ *     move 3*n; the vectors are initialized (first touched) by the
+ *     threads that use them; the results are validated against the
+ *     values the recurrence should produce, with a relative average
+ *     error of at most 1e-13.
+ * 2.  STREAM requires each vector to be at least four times the size
+ *     of the last level cache, and the times to be at least 20 clock
+ *     ticks.  A warning is printed when either doesn't hold.  n
+ *     (default 10000000, STREAM's default) should be evenly divisible
+ *     by comm_sz.
+ * 3.  The MPI path puts barriers around each kernel and uses the
+ *     maximum time over the processes, like STREAM's MPI version.
+ *     While process 0 runs the threaded path the other processes wait
+ *     in Idle_barrier, which sleeps instead of spinning, so they
+ *     don't take cores from its threads.
+ * 4.  STREAM's Scale isn't in place, so it's Vector_scale, not
+ *     Parallel_scalar_multiplication.  The kernels are the ones of
+ *     lab3_kernels.c:  each thread calls them on its block.
+ * 5.  thread_count defaults to 1, and can't be more than 1 if the
+ *     program is compiled without OpenMP.
+ *
+ * IPP:  Section 3.4.6 (pp. 109 and ff.)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "lab3_kernels.h"
+
+#define KERNELS 4
+#define SCALAR 3.0
+#define EPS 1.0e-13
+#define MIN_TICKS 20
+/* Sleep between the tests of Idle_barrier, in microseconds */
+#define IDLE_US 1000
+
+void Check_for_error(int local_ok, char fname[], char message[],
+      MPI_Comm comm);
+void Get_args(int argc, char* argv[], int* n_p, int* thread_count_p,
+      int* ntimes_p, int comm_sz, MPI_Comm comm);
+void Run_stream(char title[], int local_n, long n, int thread_count,
+      int ntimes, MPI_Comm comm);
+void Init_vectors(double a[], double b[], double c[], int local_n,
+      int thread_count);
+void Run_kernel(int k, double a[], double b[], double c[], int local_n,
+      int thread_count);
+void Thread_block(int local_n, int* first_p, int* count_p);
+void Idle_barrier(MPI_Comm comm);
+int Check_results(double a[], double b[], double c[], int local_n, long n,
+      int ntimes, int my_rank, MPI_Comm comm);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, thread_count, ntimes;
+   int comm_sz, my_rank;
+   MPI_Comm comm;
+
+   MPI_Init(&argc, &argv);
+   comm = MPI_COMM_WORLD;
+   MPI_Comm_size(comm, &comm_sz);
+   MPI_Comm_rank(comm, &my_rank);
+
+   Get_args(argc, argv, &n, &thread_count, &ntimes, comm_sz, comm);
+
+   if (my_rank == 0)
+      Run_stream("Threaded", n, n, thread_count, ntimes, MPI_COMM_SELF);
+   Idle_barrier(comm);
+   Run_stream("MPI", n/comm_sz, n, thread_count, ntimes, comm);
+
+   MPI_Finalize();
+   return 0;
+}  /* main */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_for_error
+ * Purpose:   Check whether any process has found an error.  If so,
+ *            print message and terminate all processes.  Otherwise,
+ *            continue execution.
+ * In args:   local_ok:  1 if calling process has found an error, 0
+ *               otherwise
+ *            fname:     name of function calling Check_for_error
+ *            message:   message to print if there's an error
+ *            comm:      communicator containing processes calling
+ *                       Check_for_error:  should be MPI_COMM_WORLD.
+ */
+void Check_for_error(
+      int       local_ok   /* in */,
+      char      fname[]    /* in */,
+      char      message[]  /* in */,
+      MPI_Comm  comm       /* in */) {
+   int ok;
+
+   MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, comm);
+   if (ok == 0) {
+      int my_rank;
+      MPI_Comm_rank(comm, &my_rank);
+      if (my_rank == 0) {
+         fprintf(stderr, "Proc %d > In %s, %s\n", my_rank, fname,
+               message);
+         fflush(stderr);
+      }
+      MPI_Finalize();
+      exit(-1);
+   }
+}  /* Check_for_error */
+
+/*-------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors, the threads per process
+ *            and the number of iterations from the command line
+ * In args:   argc, argv, comm_sz, comm
+ * Out args:  n_p, thread_count_p, ntimes_p
+ *
+ * Errors:    n should be positive and evenly divisible by comm_sz,
+ *            thread_count positive (and 1 if the program wasn't
+ *            compiled with OpenMP) and ntimes at least 2
+ */
+void Get_args(
+      int       argc            /* in  */,
+      char*     argv[]          /* in  */,
+      int*      n_p             /* out */,
+      int*      thread_count_p  /* out */,
+      int*      ntimes_p        /* out */,
+      int       comm_sz         /* in  */,
+      MPI_Comm  comm            /* in  */) {
+   int c, local_ok = 1;
+
+   *n_p = 10000000;
+   *thread_count_p = 1;
+   *ntimes_p = 10;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:t:k:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 't': *thread_count_p = strtol(optarg, NULL, 10); break;
+         case 'k': *ntimes_p = strtol(optarg, NULL, 10); break;
+         default:  local_ok = 0;
+      }
+   Check_for_error(local_ok, "Get_args", "usage: mpi_vector_stream "
+         "[-n <n>] [-t <thread_count>] [-k <ntimes>]", comm);
+   Check_for_error(*n_p > 0 && *n_p % comm_sz == 0, "Get_args",
+         "n should be > 0 and evenly divisible by comm_sz", comm);
+   Check_for_error(*thread_count_p > 0, "Get_args",
+         "thread_count should be > 0", comm);
+#  ifndef _OPENMP
+   Check_for_error(*thread_count_p == 1, "Get_args",
+         "thread_count should be 1 without OpenMP", comm);
+#  endif
+   Check_for_error(*ntimes_p >= 2, "Get_args",
+         "ntimes should be >= 2", comm);
+}  /* Get_args */
+
+/*-------------------------------------------------------------------
+ * Function:  Run_stream
+ * Purpose:   Run the four kernels ntimes times over the processes in
+ *            comm and print STREAM's table on process 0 of comm
+ * In args:   title:         name of the path
+ *            local_n:       elements of each vector on this process
+ *            n:             elements of each vector over comm
+ *            thread_count:  threads per process
+ *            ntimes:        iterations
+ *            comm:          processes running the path
+ *
+ * Errors:    malloc failure
+ */
+void Run_stream(
+      char      title[]       /* in */,
+      int       local_n       /* in */,
+      long      n             /* in */,
+      int       thread_count  /* in */,
+      int       ntimes        /* in */,
+      MPI_Comm  comm          /* in */) {
+   char* names[KERNELS] = {"Copy:", "Scale:", "Add:", "Triad:"};
+   double bytes[KERNELS] = {2, 2, 3, 3};
+   double avg_t[KERNELS] = {0}, min_t[KERNELS], max_t[KERNELS] = {0};
+   double *a, *b, *c, start, local_elapsed, elapsed;
+   int k, iter, my_rank, local_ok = 1;
+   long llc;
+
+   MPI_Comm_rank(comm, &my_rank);
+   a = malloc(local_n*sizeof(double));
+   b = malloc(local_n*sizeof(double));
+   c = malloc(local_n*sizeof(double));
+   if (a == NULL || b == NULL || c == NULL) local_ok = 0;
+   Check_for_error(local_ok, "Run_stream", "Can't allocate vectors",
+         comm);
+   Init_vectors(a, b, c, local_n, thread_count);
+   for (k = 0; k < KERNELS; k++) min_t[k] = 1.0e30;
+
+   for (iter = 0; iter < ntimes; iter++)
+      for (k = 0; k < KERNELS; k++) {
+         MPI_Barrier(comm);
+         start = MPI_Wtime();
+         Run_kernel(k, a, b, c, local_n, thread_count);
+         MPI_Barrier(comm);
+         local_elapsed = MPI_Wtime() - start;
+         MPI_Reduce(&local_elapsed, &elapsed, 1, MPI_DOUBLE, MPI_MAX, 0,
+               comm);
+         /* STREAM drops the first iteration */
+         if (my_rank == 0 && iter > 0) {
+            avg_t[k] += elapsed;
+            if (elapsed < min_t[k]) min_t[k] = elapsed;
+            if (elapsed > max_t[k]) max_t[k] = elapsed;
+         }
+      }
+
+   local_ok = Check_results(a, b, c, local_n, n, ntimes, my_rank, comm);
+
+   if (my_rank == 0) {
+      int size;
+      MPI_Comm_size(comm, &size);
+      printf("%s path:  n = %ld, %d process(es) x %d thread(s)\n",
+            title, n, size, thread_count);
+      llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+      if (llc <= 0) llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      if (llc > 0 && n*sizeof(double) < 4*llc)
+         printf("WARNING:  each vector (%.1f MB) should be at least 4 "
+               "times the last level cache (%.1f MB)\n",
+               n*sizeof(double)/1.0e6, llc/1.0e6);
+      for (k = 0; k < KERNELS; k++)
+         if (min_t[k] < MIN_TICKS*MPI_Wtick()) {
+            printf("WARNING:  times below %d clock ticks, increase n\n",
+                  MIN_TICKS);
+            break;
+         }
+      printf("%-8s %16s %12s %12s %12s\n", "Function", "Best Rate MB/s",
+            "Avg time", "Min time", "Max time");
+      for (k = 0; k < KERNELS; k++)
+         printf("%-8s %16.1f %12.6f %12.6f %12.6f\n", names[k],
+               1.0e-6*bytes[k]*sizeof(double)*n/min_t[k],
+               avg_t[k]/(ntimes - 1), min_t[k], max_t[k]);
+      printf("%s\n\n", local_ok ? "Solution Validates" :
+            "Solution does NOT validate");
+   }
+
+   free(a);
+   free(b);
+   free(c);
+}  /* Run_stream */
+
+/*-------------------------------------------------------------------
+ * Function:  Init_vectors
+ * Purpose:   Initialize the vectors like STREAM, with the same
+ *            schedule as the kernels so each page is first touched
+ *            by the thread that will use it
+ * In args:   local_n, thread_count
+ * Out args:  a, b, c
+ */
+void Init_vectors(
+      double  a[]           /* out */,
+      double  b[]           /* out */,
+      double  c[]           /* out */,
+      int     local_n       /* in  */,
+      int     thread_count  /* in  */) {
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int first, count, j;
+
+      Thread_block(local_n, &first, &count);
+      for (j = first; j < first + count; j++) {
+         a[j] = 2.0;
+         b[j] = 2.0;
+         c[j] = 0.0;
+      }
+   }
+}  /* Init_vectors */
+
+/*-------------------------------------------------------------------
+ * Function:  Run_kernel
+ * Purpose:   Run STREAM kernel k with thread_count threads, each of
+ *            which calls the kernel of lab3_kernels.c on its block
+ * In args:   k:  0 Copy c = a, 1 Scale b = SCALAR*c, 2 Add c = a + b,
+ *                3 Triad a = b + SCALAR*c
+ *            local_n, thread_count
+ * In/out:    a, b, c
+ */
+void Run_kernel(
+      int     k             /* in     */,
+      double  a[]           /* in/out */,
+      double  b[]           /* in/out */,
+      double  c[]           /* in/out */,
+      int     local_n       /* in     */,
+      int     thread_count  /* in     */) {
+#  pragma omp parallel num_threads(thread_count)
+   {
+      int first, count;
+
+      Thread_block(local_n, &first, &count);
+      switch (k) {
+         case 0: Vector_copy(a + first, c + first, count); break;
+         case 1: Vector_scale(c + first, b + first, SCALAR, count); break;
+         case 2: Vector_sum(a + first, b + first, c + first, count); break;
+         case 3: Vector_triad(b + first, c + first, a + first, SCALAR,
+                       count); break;
+      }
+   }
+}  /* Run_kernel */
+
+/*-------------------------------------------------------------------
+ * Function:  Thread_block
+ * Purpose:   Find the block of the calling thread in a block
+ *            distribution of local_n elements over the threads of the
+ *            team:  the first local_n % thread_count threads get one
+ *            extra element
+ * In arg:    local_n
+ * Out args:  first_p:  index of the thread's first element
+ *            count_p:  number of elements of the thread
+ */
+void Thread_block(
+      int   local_n   /* in  */,
+      int*  first_p   /* out */,
+      int*  count_p   /* out */) {
+#  ifdef _OPENMP
+   int my_rank = omp_get_thread_num();
+   int thread_count = omp_get_num_threads();
+#  else
+   int my_rank = 0;
+   int thread_count = 1;
+#  endif
+   int quotient = local_n/thread_count, remainder = local_n % thread_count;
+
+   *count_p = quotient + (my_rank < remainder);
+   *first_p = my_rank*quotient + (my_rank < remainder ? my_rank : remainder);
+}  /* Thread_block */
+
+/*-------------------------------------------------------------------
+ * Function:  Check_results
+ * Purpose:   Validate the vectors like STREAM:  repeat the kernels
+ *            ntimes times on scalars and compare the average absolute
+ *            error of each vector, relative to the expected value,
+ *            with EPS
+ * In args:   a, b, c, local_n, n, ntimes, my_rank, comm
+ * Ret val:   1 if all three vectors validate, 0 otherwise
+ * Note:      The errors are printed on process 0 of comm
+ */
+int Check_results(
+      double    a[]      /* in */,
+      double    b[]      /* in */,
+      double    c[]      /* in */,
+      int       local_n  /* in */,
+      long      n        /* in */,
+      int       ntimes   /* in */,
+      int       my_rank  /* in */,
+      MPI_Comm  comm     /* in */) {
+   double aj = 2.0, bj = 2.0, cj = 0.0;
+   double local_err[3] = {0.0, 0.0, 0.0}, err[3], expected[3];
+   char names[3] = {'a', 'b', 'c'};
+   int j, k, ok = 1;
+
+   for (k = 0; k < ntimes; k++) {
+      cj = aj;
+      bj = SCALAR*cj;
+      cj = aj + bj;
+      aj = bj + SCALAR*cj;
+   }
+   expected[0] = aj;
+   expected[1] = bj;
+   expected[2] = cj;
+
+   for (j = 0; j < local_n; j++) {
+      local_err[0] += fabs(a[j] - aj);
+      local_err[1] += fabs(b[j] - bj);
+      local_err[2] += fabs(c[j] - cj);
+   }
+   MPI_Allreduce(local_err, err, 3, MPI_DOUBLE, MPI_SUM, comm);
+
+   for (k = 0; k < 3; k++)
+      if (err[k]/n/fabs(expected[k]) > EPS) {
+         ok = 0;
+         if (my_rank == 0)
+            printf("Failed validation on vector %c:  expected %e, "
+                  "average error %e\n", names[k], expected[k], err[k]/n);
+      }
+   return ok;
+}  /* Check_results */
+
+/*-------------------------------------------------------------------
+ * Function:  Idle_barrier
+ * Purpose:   Barrier for processes that may wait a long time:  start
+ *            an MPI_Ibarrier and test it every IDLE_US microseconds,
+ *            sleeping in between, instead of spinning in MPI_Barrier
+ * In arg:    comm
+ */
+void Idle_barrier(MPI_Comm comm /* in */) {
+   MPI_Request req;
+   int done;
+
+   MPI_Ibarrier(comm, &req);
+   MPI_Test(&req, &done, MPI_STATUS_IGNORE);
+   while (!done) {
+      usleep(IDLE_US);
+      MPI_Test(&req, &done, MPI_STATUS_IGNORE);
+   }
+}  /* Idle_barrier */
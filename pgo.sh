@@ -0,0 +1,144 @@
+#!/bin/sh
+# File:     pgo.sh
+#
+# Purpose:  Build the programs with profile guided optimization and
+#           compare them with a plain Release build:
+#
+#           1.  Release build in <dir>/base
+#           2.  Instrumented build in <dir>/pgo (LAB3_PGO=GENERATE)
+#           3.  Training:  mpi_vector_add with 1 and 2 processes, out
+#               of place and in place, which runs Parallel_vector_sum
+#               and the distribution and output functions;
+#               mpi_vector_check with 1, 2 and 4 processes, which runs
+#               every shared kernel; vector_add_fixed and vector_bench,
+#               for the small and the large orders
+#           4.  Rebuild of <dir>/pgo with the profiles (LAB3_PGO=USE),
+#               linked with --emit-relocs if llvm-bolt is installed.
+#               The script fails if the kernels or the trained
+#               programs were built without a profile.
+#           5.  If llvm-bolt is installed, instrument the optimized
+#               vector_add_fixed with BOLT, train it again and reorder
+#               it
+#           6.  Print the latency of the shared kernels with each build
+#               side by side:  for small n, the ns per call of
+#               Vector_sum and Dot_product from vector_add_fixed; for
+#               large n, the ms per call of Vector_sum, the dot product
+#               and the scalar multiplication from vector_bench
+#
+# Run:      ./pgo.sh [<dir>] [<extra cmake args>...]
+#           e.g. ./pgo.sh pgo-build -DLAB3_NATIVE=ON -DLAB3_LTO=ON
+#
+# Output:   The build logs go to <dir>/*.log.  The comparisons have a
+#           line per n and kernel:  base time per call, optimized time
+#           per call, and the speedup (base/optimized).
+#
+# Notes:
+# 1.  The instrumented and the final builds use the same build
+#     directory, since gcc names the profiles after the object files,
+#     and BOLT is applied to that final build.  The kernels are in the
+#     lab3_kernels library, so every program trains them.
+# 2.  MPIEXEC can be set to the launcher command, e.g.
+#     MPIEXEC="mpiexec --oversubscribe".
+set -e
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+DIR=${1:-pgo-build}
+[ $# -gt 0 ] && shift
+mkdir -p "$DIR" && DIR=$(cd "$DIR" && pwd)
+MPIEXEC=${MPIEXEC:-mpiexec}
+PROFILES="$DIR/profiles"
+REPS=1000000
+LARGE="-n 4194304 -N 16777216 -s 1"
+
+rm -rf "$PROFILES"
+
+build() {
+   # build <name> <cmake args>...
+   name=$1
+   shift
+   echo "Building $name"
+   cmake -S "$SRC" -B "$DIR/$name" -DCMAKE_BUILD_TYPE=Release "$@" \
+      > "$DIR/$name.log" 2>&1
+   cmake --build "$DIR/$name" -j >> "$DIR/$name.log" 2>&1
+}
+
+build base "$@"
+build pgo -DLAB3_PGO=GENERATE -DLAB3_PGO_DIR="$PROFILES" "$@"
+
+echo "Training"
+: > "$DIR/train.log"
+for p in 1 2; do
+   $MPIEXEC -n $p "$DIR/pgo/mpi_vector_add" -o hash >> "$DIR/train.log"
+   $MPIEXEC -n $p "$DIR/pgo/mpi_vector_add" -i -s 2 -o headtail \
+      >> "$DIR/train.log"
+done
+for p in 1 2 4; do
+   $MPIEXEC -n $p "$DIR/pgo/mpi_vector_check" 20 12345 >> "$DIR/train.log"
+done
+"$DIR/pgo/vector_add_fixed" -r $REPS >> "$DIR/train.log"
+"$DIR/pgo/vector_bench" -t 1 >> "$DIR/train.log"
+
+BOLT=
+command -v llvm-bolt > /dev/null 2>&1 && BOLT=yes
+if [ -n "$BOLT" ]; then
+   build pgo -DLAB3_PGO=USE -DLAB3_PGO_DIR="$PROFILES" \
+      -DCMAKE_EXE_LINKER_FLAGS=-Wl,--emit-relocs "$@"
+else
+   build pgo -DLAB3_PGO=USE -DLAB3_PGO_DIR="$PROFILES" "$@"
+fi
+# gcc names the profiles it misses in -Wmissing-profile warnings
+if grep 'Wmissing-profile' "$DIR/pgo.log" | grep -q \
+      -e lab3_kernels -e lab3_output -e mpi_vector_add.c \
+      -e mpi_vector_check.c -e vector_add_fixed.c -e vector_bench.c; then
+   echo "Trained objects were built without profiles, see $DIR/pgo.log"
+   exit 1
+fi
+echo "Objects without profiles (not trained):" \
+   "$(grep -c 'Wmissing-profile' "$DIR/pgo.log" || true)"
+OPT="$DIR/pgo/vector_add_fixed"
+
+if [ -n "$BOLT" ]; then
+   echo "Optimizing vector_add_fixed with BOLT"
+   llvm-bolt "$OPT" -instrument \
+      -instrumentation-file="$DIR/pgo/vector_add_fixed.fdata" \
+      -o "$OPT.inst" > "$DIR/bolt.log" 2>&1
+   "$OPT.inst" -r $REPS >> "$DIR/train.log"
+   llvm-bolt "$OPT" -o "$OPT.bolt" \
+      -data="$DIR/pgo/vector_add_fixed.fdata" -reorder-blocks=ext-tsp \
+      -reorder-functions=hfsort -split-functions -split-all-cold \
+      -dyno-stats >> "$DIR/bolt.log" 2>&1
+   OPT="$OPT.bolt"
+else
+   echo "llvm-bolt not found, skipping BOLT"
+fi
+
+echo
+echo "Small n:  base ns/call, $(basename "$OPT") ns/call, speedup"
+"$DIR/base/vector_add_fixed" -r $REPS > "$DIR/base.out"
+"$OPT" -r $REPS > "$DIR/opt.out"
+awk 'NR == FNR { if ($1 ~ /^[0-9]+$/) base[$1] = $3 " " $6; next }
+     $1 ~ /^[0-9]+$/ && ($1 in base) {
+        split(base[$1], b, " ")
+        printf "%6d %-12s %8.2f %8.2f %6.2f\n", $1, "Vector_sum",
+           b[1], $3, b[1]/$3
+        printf "%6d %-12s %8.2f %8.2f %6.2f\n", $1, "Dot_product",
+           b[2], $6, b[2]/$6
+     }' "$DIR/base.out" "$DIR/opt.out"
+
+echo
+echo "Large n:  base ms/call, vector_bench (pgo) ms/call, speedup"
+"$DIR/base/vector_bench" $LARGE > "$DIR/base.out"
+"$DIR/pgo/vector_bench" $LARGE > "$DIR/opt.out"
+# vector_bench prints GB/s:  ms per call = bytes per element*n/(GB/s*1e6)
+awk 'BEGIN { split("Vector_sum dot_product scalar_mult", name, " ")
+             split("24 16 32", bytes, " ") }
+     NR == FNR { if ($1 ~ /^[0-9]+$/) base[$1] = $3 " " $4 " " $5; next }
+     $1 ~ /^[0-9]+$/ && ($1 in base) {
+        split(base[$1], b, " ")
+        for (k = 1; k <= 3; k++) {
+           tb = bytes[k]*$1/(b[k]*1e6)
+           to = bytes[k]*$1/($(k+2)*1e6)
+           printf "%10d %-12s %8.3f %8.3f %6.2f\n", $1, name[k], tb, to,
+              tb/to
+        }
+     }' "$DIR/base.out" "$DIR/opt.out"
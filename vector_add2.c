@@ -3,10 +3,11 @@
  * Purpose:  Implement vector addition
  *
  * Compile:  gcc -g -Wall -o vector_add vector_add.c
- * Run:      ./vector_add
+ * Run:      ./vector_add [-o <mode>]
  *
  * Input:    The order of the vectors, n, and the vectors x and y
- * Output:   The sum vector z = x+y
+ * Output:   The sum vector z = x+y, shown according to the output
+ *           mode:  none, headtail (default), checksum or full
  *
  * Note:
  *    If the program detects an error (order of vector <= 0 or malloc
@@ -16,22 +17,38 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
+/* Number of elements shown at each end in the headtail output mode */
+#define HEAD_TAIL_COUNT 10
+
+typedef enum {OUTPUT_NONE, OUTPUT_HEAD_TAIL, OUTPUT_CHECKSUM,
+      OUTPUT_FULL} output_mode_t;
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], output_mode_t* mode_p);
 void Read_n(int* n_p);
 void Allocate_vectors(double** x_pp, double** y_pp, double** z_pp, int n);
 void Read_vector(double a[], int n, char vec_name[]);
 void Print_vector(double b[], int n, char title[]);
+void Output_vector(double b[], int n, char title[], output_mode_t mode);
+void Print_head_tail(double b[], int n, int count, char title[]);
+void Print_checksum(double b[], int n, char title[]);
 void Vector_sum(double x[], double y[], double z[], int n);
 
 /*---------------------------------------------------------------------*/
-int main(void) {
+int main(int argc, char* argv[]) {
    int n = 100000;
    double *x, *y, *z;
+   output_mode_t mode = OUTPUT_HEAD_TAIL;
 
    clock_t start, end;
    double execution_time;
 
+   Get_args(argc, argv, &mode);
+
    srand(time(NULL));
 
    start = clock();
@@ -50,45 +67,12 @@ int main(void) {
 
    execution_time = ((double) (end - start)) / CLOCKS_PER_SEC * 1000;
    
-   // Imprimir primeros y últimos 10 elementos de cada vector
-   printf("Vector x (primeros 10):\n");
-   for (int i = 0; i < 10; i++) {
-      printf("%f ", x[i]);
-   }
-   printf("\n");
-   
-   printf("Vector x (últimos 10):\n");
-   for (int i = n - 10; i < n; i++) {
-      printf("%f ", x[i]);
-   }
-   printf("\n");
-
-   printf("Vector y (primeros 10):\n");
-   for (int i = 0; i < 10; i++) {
-      printf("%f ", y[i]);
-   }
-   printf("\n");
-   
-   printf("Vector y (últimos 10):\n");
-   for (int i = n - 10; i < n; i++) {
-      printf("%f ", y[i]);
-   }
-   printf("\n");
-
-   printf("Vector z (primeros 10):\n");
-   for (int i = 0; i < 10; i++) {
-      printf("%f ", z[i]);
-   }
-   printf("\n");
-   
-   printf("Vector z (últimos 10):\n");
-   for (int i = n - 10; i < n; i++) {
-      printf("%f ", z[i]);
-   }
-   printf("\n");
-
    printf("Execution Time (ms): %f\n", execution_time);
 
+   Output_vector(x, n, "Vector x", mode);
+   Output_vector(y, n, "Vector y", mode);
+   Output_vector(z, n, "Vector z", mode);
+
    free(x);
    free(y);
    free(z);
@@ -96,6 +80,54 @@ int main(void) {
    return 0;
 }  /* main */
 
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing how to run the program and the
+ *            output modes
+ * In arg:    prog_name:  name of the program
+ */
+void Usage(char prog_name[] /* in */) {
+   fprintf(stderr, "usage: %s [-o <mode>]\n", prog_name);
+   fprintf(stderr, "   mode:  none      print nothing\n");
+   fprintf(stderr, "          headtail  first and last %d elements\n",
+         HEAD_TAIL_COUNT);
+   fprintf(stderr, "          checksum  sum of the elements\n");
+   fprintf(stderr, "          full      all the elements\n");
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the output mode from the command line
+ * In args:   argc, argv:  command line
+ * In/out arg:  mode_p:  on input the default output mode, on output
+ *                       the mode selected with -o, if any
+ *
+ * Errors:    If an option or mode isn't recognized, the program
+ *            prints a usage message and terminates
+ */
+void Get_args(
+      int             argc     /* in     */,
+      char*           argv[]   /* in     */,
+      output_mode_t*  mode_p   /* in/out */) {
+   int c;
+
+   opterr = 0;
+   while ((c = getopt(argc, argv, "o:")) != -1) {
+      if (c == 'o' && strcmp(optarg, "none") == 0)
+         *mode_p = OUTPUT_NONE;
+      else if (c == 'o' && strcmp(optarg, "headtail") == 0)
+         *mode_p = OUTPUT_HEAD_TAIL;
+      else if (c == 'o' && strcmp(optarg, "checksum") == 0)
+         *mode_p = OUTPUT_CHECKSUM;
+      else if (c == 'o' && strcmp(optarg, "full") == 0)
+         *mode_p = OUTPUT_FULL;
+      else {
+         Usage(argv[0]);
+         exit(-1);
+      }
+   }
+}  /* Get_args */
+
 /*---------------------------------------------------------------------
  * Function:  Read_n
  * Purpose:   Get the order of the vectors from stdin
@@ -169,6 +201,84 @@ void Print_vector(
    printf("\n");
 }  /* Print_vector */
 
+/*---------------------------------------------------------------------
+ * Function:  Output_vector
+ * Purpose:   Show a vector in the selected output mode
+ * In args:   b:      the vector
+ *            n:      the order of the vector
+ *            title:  title for print out
+ *            mode:   output mode
+ */
+void Output_vector(
+      double         b[]     /* in */,
+      int            n       /* in */,
+      char           title[] /* in */,
+      output_mode_t  mode    /* in */) {
+   switch (mode) {
+      case OUTPUT_HEAD_TAIL:
+         Print_head_tail(b, n, HEAD_TAIL_COUNT, title);
+         break;
+      case OUTPUT_CHECKSUM:
+         Print_checksum(b, n, title);
+         break;
+      case OUTPUT_FULL:
+         Print_vector(b, n, title);
+         break;
+      default:
+         break;
+   }
+}  /* Output_vector */
+
+/*---------------------------------------------------------------------
+ * Function:  Print_head_tail
+ * Purpose:   Print the first and the last count elements of a vector
+ * In args:   b:      the vector
+ *            n:      the order of the vector
+ *            count:  number of elements to print at each end
+ *            title:  title for print out
+ *
+ * Note:      If n <= 2*count the whole vector is printed once.
+ */
+void Print_head_tail(
+      double  b[]     /* in */,
+      int     n       /* in */,
+      int     count   /* in */,
+      char    title[] /* in */) {
+   int i;
+
+   if (n <= 2*count) {
+      Print_vector(b, n, title);
+      return;
+   }
+   printf("%s (primeros %d):\n", title, count);
+   for (i = 0; i < count; i++)
+      printf("%f ", b[i]);
+   printf("\n");
+   printf("%s (últimos %d):\n", title, count);
+   for (i = n - count; i < n; i++)
+      printf("%f ", b[i]);
+   printf("\n");
+}  /* Print_head_tail */
+
+/*---------------------------------------------------------------------
+ * Function:  Print_checksum
+ * Purpose:   Print the sum of the elements of a vector
+ * In args:   b:      the vector
+ *            n:      the order of the vector
+ *            title:  title for print out
+ */
+void Print_checksum(
+      double  b[]     /* in */,
+      int     n       /* in */,
+      char    title[] /* in */) {
+   int i;
+   double sum = 0.0;
+
+   for (i = 0; i < n; i++)
+      sum += b[i];
+   printf("%s (suma): %f\n", title, sum);
+}  /* Print_checksum */
+
 /*---------------------------------------------------------------------
  * Function:  Vector_sum
  * Purpose:   Add two vectors
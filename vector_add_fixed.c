@@ -0,0 +1,327 @@
+/* File:     vector_add_fixed.c
+ *
+ * Purpose:  Add and take dot products of tiny vectors (3 to 64
+ *           elements) with kernels whose order is a compile time
+ *           constant.  Each kernel's loop is fully unrolled, so there
+ *           is no loop counter and no tail loop, and
+ *           Vector_sum_dispatch picks the fixed size kernel when n is
+ *           one of FIXED_SIZES and falls back to Vector_sum otherwise.
+ *           The program checks every kernel against Vector_sum and
+ *           prints the latency of one call of each version in
+ *           nanoseconds.
+ *
+ * Compile:  gcc -O3 -Wall -o vector_add_fixed vector_add_fixed.c \
+ *              lab3_kernels.c -lm
+ * Run:      ./vector_add_fixed [-r <reps>]
+ *
+ * Input:    None
+ * Output:   For each n:  ns per call of Vector_sum, of
+ *           Vector_sum_dispatch and of their dot product counterparts
+ *
+ * Notes:
+ * 1.  FIXED_SIZES lists the specialized orders.  Adding an order to
+ *     the list is enough to generate its kernels and its case in the
+ *     dispatchers.  Orders not in the list, like the 10 and 50 of the
+ *     benchmark, show the cost of the fallback.
+ * 2.  The generic kernels are the ones of lab3_kernels.c, so the
+ *     compiler can't specialize them for the constant n of the
+ *     benchmark loop (unless it's built with LTO).
+ * 3.  Each time is the best of TRIALS runs of <reps> calls (default
+ *     1000000).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <unistd.h>
+#include <time.h>
+#include "lab3_kernels.h"
+
+#define TRIALS 5
+
+/* Orders with a fixed size kernel:  X(n) for each one */
+#define FIXED_SIZES(X) \
+   X(3) X(4) X(5) X(6) X(7) X(8) X(12) X(16) X(20) X(24) X(32) X(48) X(64)
+
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#define CLOBBER() __asm__ __volatile__("" : : : "memory")
+#define UNROLL _Pragma("GCC unroll 64")
+#else
+#define NOINLINE
+#define CLOBBER()
+#define UNROLL
+#endif
+
+/* Keeps the dot products from being optimized away */
+volatile double sink;
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], long* reps_p);
+double Now(void);
+void Vector_sum_dispatch(double x[], double y[], double z[], int n);
+double Dot_product_dispatch(double x[], double y[], int n);
+int Is_fixed(int n);
+int Check(int n);
+double Time_sum(int dispatch, double x[], double y[], double z[], int n,
+      long reps);
+double Time_dot(int dispatch, double x[], double y[], int n, long reps);
+
+/*-------------------------------------------------------------------
+ * Functions:  Vector_sum_<N>, Dot_product_<N>
+ * Purpose:    z = x + y and x.y for vectors of order N
+ * Note:       The loops have a constant trip count and are fully
+ *             unrolled
+ */
+#define DEFINE_FIXED(N)                                                 \
+static inline void Vector_sum_##N(double x[], double y[], double z[]) { \
+   int i;                                                               \
+   UNROLL                                                               \
+   for (i = 0; i < N; i++)                                              \
+      z[i] = x[i] + y[i];                                               \
+}                                                                       \
+                                                                        \
+static inline double Dot_product_##N(double x[], double y[]) {          \
+   int i;                                                               \
+   double dot = 0.0;                                                    \
+   UNROLL                                                               \
+   for (i = 0; i < N; i++)                                              \
+      dot += x[i]*y[i];                                                 \
+   return dot;                                                          \
+}
+
+FIXED_SIZES(DEFINE_FIXED)
+
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int sizes[] = {3, 4, 5, 8, 10, 16, 20, 32, 50, 64};
+   int count = sizeof(sizes)/sizeof(sizes[0]), s, i, n;
+   long reps;
+   double x[64], y[64], z[64];
+
+   Get_args(argc, argv, &reps);
+
+   for (i = 0; i < 64; i++) {
+      x[i] = 1.0 + i % 7;
+      y[i] = 0.5*(i % 5);
+   }
+
+   printf("%4s %7s %12s %12s %8s %12s %12s %8s\n", "n", "fixed",
+         "sum ns", "dispatch ns", "speedup", "dot ns", "dispatch ns",
+         "speedup");
+   for (s = 0; s < count; s++) {
+      double sum_ns, sum_fixed_ns, dot_ns, dot_fixed_ns;
+
+      n = sizes[s];
+      if (!Check(n)) {
+         fprintf(stderr, "Fixed size kernels of order %d are wrong\n", n);
+         exit(-1);
+      }
+      sum_ns = Time_sum(0, x, y, z, n, reps);
+      sum_fixed_ns = Time_sum(1, x, y, z, n, reps);
+      dot_ns = Time_dot(0, x, y, n, reps);
+      dot_fixed_ns = Time_dot(1, x, y, n, reps);
+      printf("%4d %7s %12.2f %12.2f %8.2f %12.2f %12.2f %8.2f\n", n,
+            Is_fixed(n) ? "yes" : "no", sum_ns, sum_fixed_ns,
+            sum_ns/sum_fixed_ns, dot_ns, dot_fixed_ns,
+            dot_ns/dot_fixed_ns);
+   }
+
+   return 0;
+}  /* main */
+
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing the command line options and
+ *            terminate
+ * In arg:    prog_name
+ */
+void Usage(char prog_name[]) {
+   fprintf(stderr, "usage: %s [-r <reps>]\n", prog_name);
+   fprintf(stderr, "   reps:  calls per timing\n");
+   exit(0);
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the number of calls per timing from the command line
+ * In args:   argc, argv
+ * Out arg:   reps_p
+ *
+ * Errors:    Unknown options and reps <= 0 print the usage message
+ */
+void Get_args(
+      int    argc    /* in  */,
+      char*  argv[]  /* in  */,
+      long*  reps_p  /* out */) {
+   int c;
+
+   *reps_p = 1000000;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "r:")) != -1)
+      switch (c) {
+         case 'r': *reps_p = strtol(optarg, NULL, 10); break;
+         default:  Usage(argv[0]);
+      }
+   if (*reps_p <= 0) Usage(argv[0]);
+}  /* Get_args */
+
+/*---------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:  Vector_sum_dispatch
+ * Purpose:   Add two vectors with the fixed size kernel of order n,
+ *            or with Vector_sum if there isn't one
+ * In args:   x, y, n
+ * Out arg:   z
+ */
+NOINLINE void Vector_sum_dispatch(double x[], double y[], double z[],
+      int n) {
+#define SUM_CASE(N) case N: Vector_sum_##N(x, y, z); return;
+   switch (n) {
+      FIXED_SIZES(SUM_CASE)
+      default: Vector_sum(x, y, z, n);
+   }
+#undef SUM_CASE
+}  /* Vector_sum_dispatch */
+
+/*---------------------------------------------------------------------
+ * Function:  Dot_product_dispatch
+ * Purpose:   Find x.y with the fixed size kernel of order n, or with
+ *            Dot_product if there isn't one
+ * In args:   x, y, n
+ */
+NOINLINE double Dot_product_dispatch(double x[], double y[], int n) {
+#define DOT_CASE(N) case N: return Dot_product_##N(x, y);
+   switch (n) {
+      FIXED_SIZES(DOT_CASE)
+      default: return Dot_product(x, y, n);
+   }
+#undef DOT_CASE
+}  /* Dot_product_dispatch */
+
+/*---------------------------------------------------------------------
+ * Function:  Is_fixed
+ * Purpose:   Return 1 if there are fixed size kernels of order n, 0
+ *            otherwise
+ */
+int Is_fixed(int n) {
+#define FIXED_CASE(N) case N:
+   switch (n) {
+      FIXED_SIZES(FIXED_CASE)
+         return 1;
+      default:
+         return 0;
+   }
+#undef FIXED_CASE
+}  /* Is_fixed */
+
+/*---------------------------------------------------------------------
+ * Function:  Check
+ * Purpose:   Compare the dispatched kernels of order n with the
+ *            generic ones
+ * Ret val:   1 if the results agree, 0 otherwise
+ * Note:      The sums must be identical.  Once unrolled, the fixed
+ *            size dot product may be vectorized or contracted into
+ *            fused multiply-adds differently from Dot_product, so the
+ *            dot products only have to agree within n*eps*sum|x*y|.
+ */
+int Check(int n) {
+   double x[64], y[64], z[64], ref[64], abs_sum = 0.0;
+   int i;
+
+   for (i = 0; i < n; i++) {
+      x[i] = (rand() % 2001)/100.0 - 10.0;
+      y[i] = (rand() % 2001)/100.0 - 10.0;
+      abs_sum += fabs(x[i]*y[i]);
+   }
+   Vector_sum(x, y, ref, n);
+   Vector_sum_dispatch(x, y, z, n);
+   if (memcmp(z, ref, n*sizeof(double)) != 0) return 0;
+   return fabs(Dot_product(x, y, n) - Dot_product_dispatch(x, y, n))
+         <= n*DBL_EPSILON*abs_sum;
+}  /* Check */
+
+/*---------------------------------------------------------------------
+ * Function:  Time_sum
+ * Purpose:   Find the time of one call of Vector_sum (dispatch = 0)
+ *            or of Vector_sum_dispatch (dispatch = 1)
+ * In args:   dispatch, x, y, n, reps
+ * Out arg:   z
+ * Ret val:   Best time per call in ns
+ */
+double Time_sum(
+      int     dispatch  /* in  */,
+      double  x[]       /* in  */,
+      double  y[]       /* in  */,
+      double  z[]       /* out */,
+      int     n         /* in  */,
+      long    reps      /* in  */) {
+   long r;
+   int t;
+   double start, elapsed, best = 1.0e30;
+
+   for (t = 0; t < TRIALS; t++) {
+      start = Now();
+      if (dispatch)
+         for (r = 0; r < reps; r++) {
+            Vector_sum_dispatch(x, y, z, n);
+            CLOBBER();
+         }
+      else
+         for (r = 0; r < reps; r++) {
+            Vector_sum(x, y, z, n);
+            CLOBBER();
+         }
+      elapsed = Now() - start;
+      if (elapsed < best) best = elapsed;
+   }
+   return best/reps*1.0e9;
+}  /* Time_sum */
+
+/*---------------------------------------------------------------------
+ * Function:  Time_dot
+ * Purpose:   Find the time of one call of Dot_product (dispatch = 0)
+ *            or of Dot_product_dispatch (dispatch = 1)
+ * In args:   dispatch, x, y, n, reps
+ * Ret val:   Best time per call in ns
+ */
+double Time_dot(
+      int     dispatch  /* in  */,
+      double  x[]       /* in  */,
+      double  y[]       /* in  */,
+      int     n         /* in  */,
+      long    reps      /* in  */) {
+   long r;
+   int t;
+   double start, elapsed, best = 1.0e30, dot = 0.0;
+
+   for (t = 0; t < TRIALS; t++) {
+      start = Now();
+      if (dispatch)
+         for (r = 0; r < reps; r++) {
+            dot += Dot_product_dispatch(x, y, n);
+            CLOBBER();
+         }
+      else
+         for (r = 0; r < reps; r++) {
+            dot += Dot_product(x, y, n);
+            CLOBBER();
+         }
+      elapsed = Now() - start;
+      if (elapsed < best) best = elapsed;
+   }
+   sink = dot;
+   return best/reps*1.0e9;
+}  /* Time_dot */
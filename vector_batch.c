@@ -0,0 +1,383 @@
+/* File:     vector_batch.c
+ *
+ * Purpose:  Add and take dot products of many small vectors of the
+ *           same order with one call.  A batch of count vectors of
+ *           order n can be stored
+ *
+ *           AoS:  vector after vector, element i of vector b at
+ *                 x[b*n + i], or
+ *           SoA:  element after element, element i of vector b at
+ *                 x[i*count + b],
+ *
+ *           and the SoA kernels vectorize across the batch instead of
+ *           along each short vector.  The program compares calling
+ *           Vector_sum and Dot_product once per vector with the batch
+ *           kernels and prints the throughput in vectors per second.
+ *
+ * Compile:  gcc -O3 -Wall -o vector_batch vector_batch.c lab3_kernels.c \
+ *              -lm
+ * Run:      ./vector_batch [-e <elements>]
+ *
+ * Input:    None
+ * Output:   For each order n, millions of vectors per second of each
+ *           version of the sum and of the dot product
+ *
+ * Notes:
+ * 1.  Each batch has about <elements> elements per operand (default
+ *     2^20), so count = elements/n.
+ * 2.  The SoA dot product works on BATCH_BLOCK vectors at a time, so
+ *     their partial dot products stay in L1 while all n elements are
+ *     added in.
+ * 3.  Every kernel adds the terms of each dot product in the same
+ *     order, but the compiler may contract them into fused
+ *     multiply-adds differently (e.g. with -march=native), so the dot
+ *     products are compared within DOT_TOL.  The sums must be
+ *     identical.
+ * 4.  Times are the best of TRIALS runs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include "lab3_kernels.h"
+
+#define TRIALS      5
+#define BATCH_BLOCK 256
+#define DOT_TOL     1.0e-9
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], long* elements_p);
+double Now(void);
+double Min(double a, double b);
+void Batch_sum_calls(double x[], double y[], double z[], int n, int count);
+void Batch_dot_calls(double x[], double y[], double dots[], int n,
+      int count);
+void Batch_sum(double x[], double y[], double z[], int n, int count);
+void Batch_dot_aos(double x[], double y[], double dots[], int n,
+      int count);
+void Batch_dot_soa(double x[], double y[], double dots[], int n,
+      int count);
+void Aos_to_soa(double aos[], double soa[], int n, int count);
+void Soa_to_aos(double soa[], double aos[], int n, int count);
+double Max_diff(double a[], double b[], int n);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int sizes[] = {3, 4, 8, 16, 32};
+   int size_count = sizeof(sizes)/sizeof(sizes[0]), s, t, n, count;
+   long elements, i;
+   double *x, *y, *z, *x_soa, *y_soa, *z_soa, *dots, *ref, *ref_dots;
+   double start, best[5];
+
+   Get_args(argc, argv, &elements);
+
+   x = malloc(elements*sizeof(double));
+   y = malloc(elements*sizeof(double));
+   z = malloc(elements*sizeof(double));
+   x_soa = malloc(elements*sizeof(double));
+   y_soa = malloc(elements*sizeof(double));
+   z_soa = malloc(elements*sizeof(double));
+   ref = malloc(elements*sizeof(double));
+   dots = malloc(elements*sizeof(double));
+   ref_dots = malloc(elements*sizeof(double));
+   if (x == NULL || y == NULL || z == NULL || x_soa == NULL
+         || y_soa == NULL || z_soa == NULL || ref == NULL || dots == NULL
+         || ref_dots == NULL) {
+      fprintf(stderr, "Can't allocate batches of %ld elements\n",
+            elements);
+      exit(-1);
+   }
+   for (i = 0; i < elements; i++) {
+      x[i] = (rand() % 2001)/100.0 - 10.0;
+      y[i] = (rand() % 2001)/100.0 - 10.0;
+   }
+
+   printf("Millions of vectors per second\n");
+   printf("%4s %9s %10s %10s %10s %10s %10s %10s\n", "n", "count",
+         "sum calls", "sum batch", "dot calls", "dot AoS", "dot SoA",
+         "transpose");
+   for (s = 0; s < size_count; s++) {
+      n = sizes[s];
+      count = elements/n;
+      Aos_to_soa(x, x_soa, n, count);
+      Aos_to_soa(y, y_soa, n, count);
+
+      /* Check every version against the per vector calls */
+      Batch_sum_calls(x, y, ref, n, count);
+      Batch_dot_calls(x, y, ref_dots, n, count);
+      Batch_sum(x, y, z, n, count);
+      Batch_sum(x_soa, y_soa, z_soa, n, count);
+      Soa_to_aos(z_soa, dots, n, count);
+      if (memcmp(z, ref, (long) n*count*sizeof(double)) != 0
+            || memcmp(dots, ref, (long) n*count*sizeof(double)) != 0) {
+         fprintf(stderr, "Batch_sum is wrong for n = %d\n", n);
+         exit(-1);
+      }
+      Batch_dot_aos(x, y, dots, n, count);
+      if (Max_diff(dots, ref_dots, count) > DOT_TOL) {
+         fprintf(stderr, "Batch_dot_aos is wrong for n = %d\n", n);
+         exit(-1);
+      }
+      Batch_dot_soa(x_soa, y_soa, dots, n, count);
+      if (Max_diff(dots, ref_dots, count) > DOT_TOL) {
+         fprintf(stderr, "Batch_dot_soa is wrong for n = %d\n", n);
+         exit(-1);
+      }
+
+      for (t = 0; t < 5; t++)
+         best[t] = 1.0e30;
+      for (t = 0; t < TRIALS; t++) {
+         start = Now();
+         Batch_sum_calls(x, y, z, n, count);
+         best[0] = Min(best[0], Now() - start);
+         start = Now();
+         Batch_sum(x_soa, y_soa, z_soa, n, count);
+         best[1] = Min(best[1], Now() - start);
+         start = Now();
+         Batch_dot_calls(x, y, dots, n, count);
+         best[2] = Min(best[2], Now() - start);
+         start = Now();
+         Batch_dot_aos(x, y, dots, n, count);
+         best[3] = Min(best[3], Now() - start);
+         start = Now();
+         Batch_dot_soa(x_soa, y_soa, dots, n, count);
+         best[4] = Min(best[4], Now() - start);
+      }
+      printf("%4d %9d", n, count);
+      for (t = 0; t < 5; t++)
+         printf(" %10.1f", count/best[t]/1.0e6);
+      start = Now();
+      Aos_to_soa(x, x_soa, n, count);
+      printf(" %10.1f\n", count/(Now() - start)/1.0e6);
+   }
+
+   free(x); free(y); free(z);
+   free(x_soa); free(y_soa); free(z_soa);
+   free(ref); free(dots); free(ref_dots);
+
+   return 0;
+}  /* main */
+
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing the command line options and
+ *            terminate
+ * In arg:    prog_name
+ */
+void Usage(char prog_name[]) {
+   fprintf(stderr, "usage: %s [-e <elements>]\n", prog_name);
+   fprintf(stderr, "   elements:  elements per operand of a batch\n");
+   exit(0);
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the size of the batches from the command line
+ * In args:   argc, argv
+ * Out arg:   elements_p
+ *
+ * Errors:    Unknown options and elements < 32 print the usage message
+ */
+void Get_args(
+      int    argc        /* in  */,
+      char*  argv[]      /* in  */,
+      long*  elements_p  /* out */) {
+   int c;
+
+   *elements_p = 1L << 20;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "e:")) != -1)
+      switch (c) {
+         case 'e': *elements_p = strtol(optarg, NULL, 10); break;
+         default:  Usage(argv[0]);
+      }
+   if (*elements_p < 32) Usage(argv[0]);
+}  /* Get_args */
+
+/*---------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:  Min
+ * Purpose:   Return the smaller of a and b
+ */
+double Min(double a, double b) {
+   return a < b ? a : b;
+}  /* Min */
+
+/*---------------------------------------------------------------------
+ * Function:  Batch_sum_calls
+ * Purpose:   Add a batch of AoS vectors with a call of Vector_sum per
+ *            vector
+ * In args:   x, y:   the batches, count vectors of order n each
+ *            n, count
+ * Out arg:   z:      the sums
+ */
+void Batch_sum_calls(
+      double  x[]    /* in  */,
+      double  y[]    /* in  */,
+      double  z[]    /* out */,
+      int     n      /* in  */,
+      int     count  /* in  */) {
+   int b;
+
+   for (b = 0; b < count; b++)
+      Vector_sum(x + (long) b*n, y + (long) b*n, z + (long) b*n, n);
+}  /* Batch_sum_calls */
+
+/*---------------------------------------------------------------------
+ * Function:  Batch_dot_calls
+ * Purpose:   Find the dot products of a batch of AoS vectors with a
+ *            call of Dot_product per vector
+ * In args:   x, y:   the batches, count vectors of order n each
+ *            n, count
+ * Out arg:   dots:   dots[b] = x_b.y_b
+ */
+void Batch_dot_calls(
+      double  x[]     /* in  */,
+      double  y[]     /* in  */,
+      double  dots[]  /* out */,
+      int     n       /* in  */,
+      int     count   /* in  */) {
+   int b;
+
+   for (b = 0; b < count; b++)
+      dots[b] = Dot_product(x + (long) b*n, y + (long) b*n, n);
+}  /* Batch_dot_calls */
+
+/*---------------------------------------------------------------------
+ * Function:  Batch_sum
+ * Purpose:   Add a batch of vectors
+ * In args:   x, y:   the batches, count vectors of order n each
+ *            n, count
+ * Out arg:   z:      the sums, in the layout of x and y
+ * Note:      Element-wise addition doesn't depend on the layout:  the
+ *            batch is added as a single vector of order n*count.
+ */
+void Batch_sum(
+      double  x[]    /* in  */,
+      double  y[]    /* in  */,
+      double  z[]    /* out */,
+      int     n      /* in  */,
+      int     count  /* in  */) {
+   long i, total = (long) n*count;
+
+   for (i = 0; i < total; i++)
+      z[i] = x[i] + y[i];
+}  /* Batch_sum */
+
+/*---------------------------------------------------------------------
+ * Function:  Batch_dot_aos
+ * Purpose:   Find the dot products of a batch of AoS vectors with one
+ *            call
+ * In args:   x, y:   the batches
+ *            n, count
+ * Out arg:   dots:   dots[b] = x_b.y_b
+ * Note:      Saves the calls, but each dot product is still a short
+ *            sequential reduction.
+ */
+void Batch_dot_aos(
+      double  x[]     /* in  */,
+      double  y[]     /* in  */,
+      double  dots[]  /* out */,
+      int     n       /* in  */,
+      int     count   /* in  */) {
+   int b, i;
+   double dot;
+
+   for (b = 0; b < count; b++) {
+      dot = 0.0;
+      for (i = 0; i < n; i++)
+         dot += x[(long) b*n + i]*y[(long) b*n + i];
+      dots[b] = dot;
+   }
+}  /* Batch_dot_aos */
+
+/*---------------------------------------------------------------------
+ * Function:  Batch_dot_soa
+ * Purpose:   Find the dot products of a batch of SoA vectors
+ * In args:   x, y:   the batches
+ *            n, count
+ * Out arg:   dots:   dots[b] = x_b.y_b
+ * Note:      The inner loop runs over BATCH_BLOCK vectors with unit
+ *            stride, so it vectorizes across the batch.
+ */
+void Batch_dot_soa(
+      double  x[]     /* in  */,
+      double  y[]     /* in  */,
+      double  dots[]  /* out */,
+      int     n       /* in  */,
+      int     count   /* in  */) {
+   int first, last, b, i;
+   long row;
+
+   for (first = 0; first < count; first += BATCH_BLOCK) {
+      last = first + BATCH_BLOCK < count ? first + BATCH_BLOCK : count;
+      for (b = first; b < last; b++)
+         dots[b] = 0.0;
+      for (i = 0; i < n; i++) {
+         row = (long) i*count;
+         for (b = first; b < last; b++)
+            dots[b] += x[row + b]*y[row + b];
+      }
+   }
+}  /* Batch_dot_soa */
+
+/*---------------------------------------------------------------------
+ * Function:  Aos_to_soa
+ * Purpose:   Convert a batch from AoS to SoA
+ * In args:   aos, n, count
+ * Out arg:   soa
+ */
+void Aos_to_soa(
+      double  aos[]  /* in  */,
+      double  soa[]  /* out */,
+      int     n      /* in  */,
+      int     count  /* in  */) {
+   int b, i;
+
+   for (b = 0; b < count; b++)
+      for (i = 0; i < n; i++)
+         soa[(long) i*count + b] = aos[(long) b*n + i];
+}  /* Aos_to_soa */
+
+/*---------------------------------------------------------------------
+ * Function:  Soa_to_aos
+ * Purpose:   Convert a batch from SoA to AoS
+ * In args:   soa, n, count
+ * Out arg:   aos
+ */
+void Soa_to_aos(
+      double  soa[]  /* in  */,
+      double  aos[]  /* out */,
+      int     n      /* in  */,
+      int     count  /* in  */) {
+   int b, i;
+
+   for (b = 0; b < count; b++)
+      for (i = 0; i < n; i++)
+         aos[(long) b*n + i] = soa[(long) i*count + b];
+}  /* Soa_to_aos */
+
+/*---------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Return the largest |a[i] - b[i]|
+ */
+double Max_diff(double a[], double b[], int n) {
+   int i;
+   double diff = 0.0;
+
+   for (i = 0; i < n; i++)
+      if (fabs(a[i] - b[i]) > diff) diff = fabs(a[i] - b[i]);
+   return diff;
+}  /* Max_diff */
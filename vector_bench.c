@@ -0,0 +1,347 @@
+/* File:     vector_bench.c
+ *
+ * Purpose:  Measure the bandwidth of the local parts of the vector
+ *           kernels (Vector_sum, the loop of Parallel_dot_product and
+ *           the loop of Parallel_scalar_multiplication) for vector
+ *           orders from a few hundred elements (L1) to hundreds of
+ *           megabytes (DRAM), and find the plateaus of the
+ *           bandwidth-vs-size curve.
+ *
+ * Compile:  gcc -O3 -Wall -o vector_bench vector_bench.c lab3_kernels.c -lm
+ * Run:      ./vector_bench [-n <min n>] [-N <max n>] [-s <steps>]
+ *                 [-c <cpu>] [-t <ms>]
+ *
+ * Input:    None
+ * Output:   For each n, the working set and the best bandwidth of
+ *           each kernel in GB/s, followed by the plateaus found in
+ *           each curve and the cache sizes reported by the system.
+ *
+ * Notes:
+ * 1.  n grows geometrically from min n (default 256) to max n
+ *     (default 2^24) with <steps> points per doubling (default 4).
+ * 2.  The calling thread is pinned to <cpu> (default:  the cpu it is
+ *     running on) so the caches don't change under the measurement.
+ * 3.  Each measurement runs the kernel enough times to take about
+ *     <ms> milliseconds (default 2), and measurements are repeated
+ *     until the best one hasn't improved by more than 1% in STABLE
+ *     consecutive measurements (at most MAX_SAMPLES).
+ * 4.  Bytes moved per element:  Vector_sum 24 (load x, y, store z),
+ *     dot product 16 (load x, y), scalar multiplication 32 (load and
+ *     store x and y).  Write-allocate traffic isn't counted.
+ * 5.  A plateau is a run of at least 3 consecutive sizes whose
+ *     bandwidths are within PLATEAU_TOL of the run's first one.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include "lab3_kernels.h"
+
+#define KERNEL_COUNT 3
+#define MAX_POINTS   256
+#define STABLE       5
+#define MAX_SAMPLES  60
+#define PLATEAU_TOL  0.15
+
+typedef struct {
+   int    n;
+   double gbs[KERNEL_COUNT];
+} point_t;
+
+static const char* kernel_names[KERNEL_COUNT] =
+      {"Vector_sum", "dot_product", "scalar_mult"};
+static const int kernel_bytes[KERNEL_COUNT] = {24, 16, 32};
+static const int kernel_vectors[KERNEL_COUNT] = {3, 2, 2};
+
+/* Keeps the dot products from being optimized away */
+volatile double sink;
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], int* min_n_p, int* max_n_p,
+      int* steps_p, int* cpu_p, double* target_ms_p);
+void Pin_thread(int cpu);
+double Now(void);
+void Run_kernel(int k, double x[], double y[], double z[], int n,
+      long reps);
+double Measure(int k, double x[], double y[], double z[], int n,
+      double target_ms);
+long Working_set(int k, int n);
+void Print_plateaus(point_t points[], int count, int k);
+void Print_caches(void);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int min_n, max_n, steps, cpu, count = 0, i, k, n, prev_n = 0;
+   double target_ms, *x, *y, *z;
+   point_t points[MAX_POINTS];
+
+   Get_args(argc, argv, &min_n, &max_n, &steps, &cpu, &target_ms);
+   Pin_thread(cpu);
+
+   x = malloc(max_n*sizeof(double));
+   y = malloc(max_n*sizeof(double));
+   z = malloc(max_n*sizeof(double));
+   if (x == NULL || y == NULL || z == NULL) {
+      fprintf(stderr, "Can't allocate vectors of order %d\n", max_n);
+      exit(-1);
+   }
+   for (i = 0; i < max_n; i++) {
+      x[i] = 1.0 + i % 7;
+      y[i] = 2.0 - i % 5;
+      z[i] = 0.0;
+   }
+
+   printf("%10s %12s", "n", "x,y,z KiB");
+   for (k = 0; k < KERNEL_COUNT; k++)
+      printf(" %12s", kernel_names[k]);
+   printf("   (GB/s)\n");
+
+   for (i = 0; count < MAX_POINTS; i++) {
+      n = (int) (min_n*pow(2.0, (double) i/steps) + 0.5);
+      if (n > max_n) break;
+      if (n == prev_n) continue;
+      prev_n = n;
+      points[count].n = n;
+      printf("%10d %12.1f", n, 3.0*n*sizeof(double)/1024);
+      for (k = 0; k < KERNEL_COUNT; k++) {
+         points[count].gbs[k] = Measure(k, x, y, z, n, target_ms);
+         printf(" %12.2f", points[count].gbs[k]);
+      }
+      printf("\n");
+      fflush(stdout);
+      count++;
+   }
+
+   printf("\n");
+   for (k = 0; k < KERNEL_COUNT; k++)
+      Print_plateaus(points, count, k);
+   Print_caches();
+
+   free(x);
+   free(y);
+   free(z);
+
+   return 0;
+}  /* main */
+
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing the command line options and
+ *            terminate
+ * In arg:    prog_name
+ */
+void Usage(char prog_name[]) {
+   fprintf(stderr, "usage: %s [-n <min n>] [-N <max n>] [-s <steps>]"
+         " [-c <cpu>] [-t <ms>]\n", prog_name);
+   fprintf(stderr, "   steps:  sizes per doubling of n\n");
+   fprintf(stderr, "   cpu:    cpu the thread is pinned to\n");
+   fprintf(stderr, "   ms:     duration of each measurement\n");
+   exit(0);
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the sweep parameters from the command line
+ * In args:   argc, argv
+ * Out args:  min_n_p, max_n_p:  range of vector orders
+ *            steps_p:           sizes per doubling
+ *            cpu_p:             cpu to pin the thread to
+ *            target_ms_p:       duration of a measurement
+ *
+ * Errors:    Unknown options and 0 < min n <= max n, steps > 0 and
+ *            ms > 0 violations print the usage message
+ */
+void Get_args(
+      int      argc         /* in  */,
+      char*    argv[]       /* in  */,
+      int*     min_n_p      /* out */,
+      int*     max_n_p      /* out */,
+      int*     steps_p      /* out */,
+      int*     cpu_p        /* out */,
+      double*  target_ms_p  /* out */) {
+   int c;
+
+   *min_n_p = 256;
+   *max_n_p = 1 << 24;
+   *steps_p = 4;
+   *cpu_p = sched_getcpu();
+   *target_ms_p = 2.0;
+
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:N:s:c:t:")) != -1)
+      switch (c) {
+         case 'n': *min_n_p = strtol(optarg, NULL, 10); break;
+         case 'N': *max_n_p = strtol(optarg, NULL, 10); break;
+         case 's': *steps_p = strtol(optarg, NULL, 10); break;
+         case 'c': *cpu_p = strtol(optarg, NULL, 10); break;
+         case 't': *target_ms_p = strtod(optarg, NULL); break;
+         default:  Usage(argv[0]);
+      }
+   if (*min_n_p <= 0 || *max_n_p < *min_n_p || *steps_p <= 0
+         || *target_ms_p <= 0.0)
+      Usage(argv[0]);
+}  /* Get_args */
+
+/*---------------------------------------------------------------------
+ * Function:  Pin_thread
+ * Purpose:   Bind the calling thread to a cpu
+ * In arg:    cpu
+ * Note:      If the cpu can't be used, print a warning and run
+ *            unpinned
+ */
+void Pin_thread(int cpu) {
+   cpu_set_t set;
+
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   if (cpu < 0 || sched_setaffinity(0, sizeof(set), &set) != 0)
+      fprintf(stderr, "Warning:  can't pin to cpu %d, running unpinned\n",
+            cpu);
+   else
+      printf("Pinned to cpu %d\n", cpu);
+}  /* Pin_thread */
+
+/*---------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:  Run_kernel
+ * Purpose:   Run kernel k reps times on vectors of order n
+ * Note:      The scalar alternates between 2 and 0.5, so x and y
+ *            stay bounded and exact however many times they are
+ *            scaled
+ */
+void Run_kernel(
+      int     k     /* in     */,
+      double  x[]   /* in/out */,
+      double  y[]   /* in/out */,
+      double  z[]   /* out    */,
+      int     n     /* in     */,
+      long    reps  /* in     */) {
+   long r;
+   double dot = 0.0;
+
+   for (r = 0; r < reps; r++)
+      switch (k) {
+         case 0:  Vector_sum(x, y, z, n); break;
+         case 1:  dot += Dot_product(x, y, n); break;
+         default: Parallel_scalar_multiplication(x, y, r % 2 ? 0.5 : 2.0, n);
+      }
+   sink = dot + z[n/2];
+}  /* Run_kernel */
+
+/*---------------------------------------------------------------------
+ * Function:  Measure
+ * Purpose:   Find the best bandwidth of kernel k on vectors of order n
+ * In args:   k, n, target_ms
+ * In/out:    x, y, z
+ * Ret val:   Bandwidth in GB/s of the fastest measurement
+ * Note:      The number of repetitions per measurement is doubled
+ *            until a measurement takes target_ms; reps is kept even
+ *            so the scaled vectors return to their initial values.
+ */
+double Measure(
+      int     k          /* in     */,
+      double  x[]        /* in/out */,
+      double  y[]        /* in/out */,
+      double  z[]        /* in/out */,
+      int     n          /* in     */,
+      double  target_ms  /* in     */) {
+   long reps = 2;
+   int samples, unchanged = 0;
+   double start, elapsed, best;
+
+   /* Warm up and calibrate */
+   for (;;) {
+      start = Now();
+      Run_kernel(k, x, y, z, n, reps);
+      elapsed = Now() - start;
+      if (elapsed*1000 >= target_ms) break;
+      reps *= 2;
+   }
+   best = elapsed;
+
+   for (samples = 0; samples < MAX_SAMPLES && unchanged < STABLE;
+         samples++) {
+      start = Now();
+      Run_kernel(k, x, y, z, n, reps);
+      elapsed = Now() - start;
+      if (elapsed < 0.99*best) unchanged = 0;
+      else unchanged++;
+      if (elapsed < best) best = elapsed;
+   }
+
+   return (double) kernel_bytes[k]*n*reps/best/1.0e9;
+}  /* Measure */
+
+/*---------------------------------------------------------------------
+ * Function:  Working_set
+ * Purpose:   Return the number of bytes kernel k touches on vectors
+ *            of order n
+ */
+long Working_set(int k, int n) {
+   return (long) kernel_vectors[k]*n*sizeof(double);
+}  /* Working_set */
+
+/*---------------------------------------------------------------------
+ * Function:  Print_plateaus
+ * Purpose:   Print the plateaus of the curve of kernel k and the
+ *            changes in bandwidth between them
+ * In args:   points, count:  the curve
+ *            k:              the kernel
+ */
+void Print_plateaus(point_t points[], int count, int k) {
+   int first = 0, last;
+   double sum, change, prev_gbs = 0.0;
+
+   printf("%s plateaus (working set, GB/s):\n", kernel_names[k]);
+   while (first < count) {
+      last = first;
+      sum = points[first].gbs[k];
+      while (last + 1 < count && fabs(points[last+1].gbs[k]
+               - points[first].gbs[k]) <= PLATEAU_TOL*points[first].gbs[k]) {
+         last++;
+         sum += points[last].gbs[k];
+      }
+      if (last - first + 1 >= 3) {
+         change = 100.0*(sum/(last - first + 1)/prev_gbs - 1.0);
+         if (prev_gbs > 0.0)
+            printf("   %s of %.0f%%\n", change < 0.0 ? "drop" : "rise",
+                  fabs(change));
+         printf("   %10.1f KiB - %10.1f KiB:  %8.2f\n",
+               (double) Working_set(k, points[first].n)/1024,
+               (double) Working_set(k, points[last].n)/1024,
+               sum/(last - first + 1));
+         prev_gbs = sum/(last - first + 1);
+      }
+      first = last + 1;
+   }
+}  /* Print_plateaus */
+
+/*---------------------------------------------------------------------
+ * Function:  Print_caches
+ * Purpose:   Print the data cache sizes reported by the system so
+ *            they can be compared with the plateaus
+ */
+void Print_caches(void) {
+   long l1 = 0, l2 = 0, l3 = 0;
+
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+   l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+   l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+   l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+   printf("Caches reported by the system:  L1d %ld KiB, L2 %ld KiB,"
+         " L3 %ld KiB\n", l1/1024, l2/1024, l3/1024);
+}  /* Print_caches */
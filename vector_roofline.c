@@ -0,0 +1,353 @@
+/* File:     vector_roofline.c
+ *
+ * Purpose:  Place the vector kernels on a roofline of the local
+ *           machine.  The program measures the bandwidth of a triad
+ *           (a = b + s*c) with working sets that fit in L2, in L3 and
+ *           only in DRAM, and the peak floating point rate of a loop
+ *           of independent multiply-adds.  Then it times Vector_sum,
+ *           the loop of Parallel_dot_product and the loop of
+ *           Parallel_scalar_multiplication and prints, for each, its
+ *           arithmetic intensity, the rate it attains and the
+ *           percentage of the roofline bound at its intensity.
+ *
+ * Compile:  gcc -O3 -march=native -Wall -o vector_roofline \
+ *              vector_roofline.c lab3_kernels.c -lm
+ * Run:      ./vector_roofline [-n <n>] [-m <max MiB>]
+ *
+ * Input:    None
+ * Output:   The machine peaks, the ridge points, and a line per
+ *           kernel
+ *
+ * Notes:
+ * 1.  n is the order of the vectors of the kernels (default
+ *     10000000, as in mpi_vector_add.c).  The kernels are bound by the
+ *     bandwidth of the level their working set fits in.
+ * 2.  The DRAM triad uses four times the L3 size, but no more than
+ *     <max MiB> (default 1024) for its three arrays.
+ * 3.  The peaks are per core:  the program runs a single thread, as
+ *     each MPI process of the vector programs does.  They depend on
+ *     the instruction set the compiler is allowed to use, so compile
+ *     with -march=native (FMA, AVX) to see the real peak.
+ * 4.  If the system doesn't report the cache sizes, 1 MiB of L2 and
+ *     32 MiB of L3 are assumed.
+ * 5.  Bytes are counted as in STREAM, without write-allocate traffic.
+ *     The triad's store misses cost an extra read of a, but the
+ *     in-place scalar multiplication doesn't have them, so it can
+ *     show more than 100% of the roofline bound.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "lab3_kernels.h"
+
+#define TRIALS      10
+#define MIN_TIME    0.02   /* seconds per trial */
+#define FMA_CHAINS  32
+#define FMA_ITERS   2000000
+
+typedef enum {LEVEL_L2, LEVEL_L3, LEVEL_DRAM} level_t;
+
+typedef struct {
+   char*  name;
+   double flops;     /* per element */
+   double bytes;     /* per element */
+   int    vectors;   /* vectors in the working set */
+} kernel_info_t;
+
+static const char* level_names[] = {"L2", "L3", "DRAM"};
+static const kernel_info_t kernels[] = {
+   {"Vector_sum",  1.0, 24.0, 3},
+   {"dot_product", 2.0, 16.0, 2},
+   {"scalar_mult", 2.0, 32.0, 2}
+};
+#define KERNEL_COUNT (sizeof(kernels)/sizeof(kernels[0]))
+
+/* Keeps results from being optimized away */
+volatile double sink;
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], int* n_p, long* max_bytes_p);
+double Now(void);
+void Get_caches(long* l2_p, long* l3_p);
+void Run_kernel(int k, double a[], double b[], double c[], int n);
+double Time_kernel(int k, double a[], double b[], double c[], int n);
+double Triad_bandwidth(long bytes);
+double Fma_peak(void);
+level_t Level_of(long bytes, long l2, long l3);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n, k, i;
+   long max_bytes, l2, l3, dram_bytes, working_set;
+   double bw[3], peak, elapsed, gflops, intensity, bound;
+   double *a, *b, *c;
+   level_t level;
+
+   Get_args(argc, argv, &n, &max_bytes);
+   Get_caches(&l2, &l3);
+
+   dram_bytes = 4*l3 < max_bytes ? 4*l3 : max_bytes;
+   if (dram_bytes <= l3)
+      fprintf(stderr, "Warning:  the DRAM working set (%ld MiB) isn't "
+            "larger than L3 (%ld MiB)\n", dram_bytes >> 20, l3 >> 20);
+
+   bw[LEVEL_L2] = Triad_bandwidth(l2/2);
+   bw[LEVEL_L3] = Triad_bandwidth(l2 + (l3 - l2)/2);
+   bw[LEVEL_DRAM] = Triad_bandwidth(dram_bytes);
+   peak = Fma_peak();
+
+   printf("Peak floating point rate:  %8.2f GFLOP/s\n", peak);
+   for (i = LEVEL_L2; i <= LEVEL_DRAM; i++)
+      printf("%-4s triad bandwidth:      %8.2f GB/s, ridge point "
+            "%.2f FLOP/byte\n", level_names[i], bw[i], peak/bw[i]);
+   printf("\n");
+
+   a = malloc(n*sizeof(double));
+   b = malloc(n*sizeof(double));
+   c = malloc(n*sizeof(double));
+   if (a == NULL || b == NULL || c == NULL) {
+      fprintf(stderr, "Can't allocate vectors of order %d\n", n);
+      exit(-1);
+   }
+   for (i = 0; i < n; i++) {
+      a[i] = 0.0;
+      b[i] = 1.0 + i % 7;
+      c[i] = 2.0 - i % 5;
+   }
+
+   printf("n = %d\n", n);
+   printf("%-12s %6s %10s %9s %9s %9s %7s  %s\n", "kernel", "level",
+         "FLOP/byte", "time(ms)", "GB/s", "GFLOP/s", "%peak", "bound");
+   for (k = 0; k < KERNEL_COUNT; k++) {
+      working_set = (long) kernels[k].vectors*n*sizeof(double);
+      level = Level_of(working_set, l2, l3);
+      intensity = kernels[k].flops/kernels[k].bytes;
+      bound = intensity*bw[level] < peak ? intensity*bw[level] : peak;
+      elapsed = Time_kernel(k, a, b, c, n);
+      gflops = kernels[k].flops*n/elapsed/1.0e9;
+      printf("%-12s %6s %10.3f %9.3f %9.2f %9.2f %6.1f%%  %s\n",
+            kernels[k].name, level_names[level], intensity,
+            elapsed*1000, kernels[k].bytes*n/elapsed/1.0e9, gflops,
+            100.0*gflops/bound,
+            intensity < peak/bw[level] ? "memory" : "compute");
+   }
+
+   free(a);
+   free(b);
+   free(c);
+
+   return 0;
+}  /* main */
+
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing the command line options and
+ *            terminate
+ * In arg:    prog_name
+ */
+void Usage(char prog_name[]) {
+   fprintf(stderr, "usage: %s [-n <n>] [-m <max MiB>]\n", prog_name);
+   fprintf(stderr, "   n:        order of the vectors of the kernels\n");
+   fprintf(stderr, "   max MiB:  limit of the DRAM triad arrays\n");
+   exit(0);
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the order of the vectors and the memory limit from
+ *            the command line
+ * In args:   argc, argv
+ * Out args:  n_p:          order of the vectors of the kernels
+ *            max_bytes_p:  limit of the DRAM triad arrays in bytes
+ *
+ * Errors:    Unknown options, n <= 0 or max MiB <= 0 print the usage
+ *            message
+ */
+void Get_args(
+      int    argc         /* in  */,
+      char*  argv[]       /* in  */,
+      int*   n_p          /* out */,
+      long*  max_bytes_p  /* out */) {
+   int c;
+
+   *n_p = 10000000;
+   *max_bytes_p = 1024L << 20;
+
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:m:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         case 'm': *max_bytes_p = strtol(optarg, NULL, 10) << 20; break;
+         default:  Usage(argv[0]);
+      }
+   if (*n_p <= 0 || *max_bytes_p <= 0) Usage(argv[0]);
+}  /* Get_args */
+
+/*---------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_caches
+ * Purpose:   Get the sizes in bytes of the L2 and L3 caches
+ * Out args:  l2_p, l3_p
+ */
+void Get_caches(long* l2_p, long* l3_p) {
+   *l2_p = *l3_p = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+   *l2_p = sysconf(_SC_LEVEL2_CACHE_SIZE);
+   *l3_p = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+   if (*l2_p <= 0) *l2_p = 1L << 20;
+   if (*l3_p <= *l2_p) *l3_p = 32L << 20;
+}  /* Get_caches */
+
+/*---------------------------------------------------------------------
+ * Function:  Run_kernel
+ * Purpose:   Run kernel k once on vectors of order n
+ * In args:   k, n
+ * In/out:    a, b, c
+ * Note:      Kernel 0 is Vector_sum a = b + c, kernel 1 is the dot
+ *            product b.c, and kernel 2 multiplies b and c by a scalar
+ *            that alternates between 2 and 0.5.  Kernel -1 is the
+ *            triad a = b + 3*c.
+ */
+void Run_kernel(
+      int     k    /* in     */,
+      double  a[]  /* in/out */,
+      double  b[]  /* in/out */,
+      double  c[]  /* in/out */,
+      int     n    /* in     */) {
+   static double scalar = 2.0;
+
+   switch (k) {
+      case -1:
+         Vector_triad(b, c, a, 3.0, n);
+         break;
+      case 0:
+         Vector_sum(b, c, a, n);
+         break;
+      case 1:
+         sink = Dot_product(b, c, n);
+         break;
+      default:
+         Parallel_scalar_multiplication(b, c, scalar, n);
+         scalar = 1.0/scalar;
+   }
+}  /* Run_kernel */
+
+/*---------------------------------------------------------------------
+ * Function:  Time_kernel
+ * Purpose:   Find the best time of one run of kernel k
+ * In args:   k, n
+ * In/out:    a, b, c
+ * Ret val:   The time in seconds
+ * Note:      Each of the TRIALS trials runs the kernel enough times
+ *            to take MIN_TIME, so short kernels are timed reliably.
+ */
+double Time_kernel(
+      int     k    /* in     */,
+      double  a[]  /* in/out */,
+      double  b[]  /* in/out */,
+      double  c[]  /* in/out */,
+      int     n    /* in     */) {
+   long reps = 1, r;
+   int t;
+   double start, elapsed, best = 1.0e30;
+
+   Run_kernel(k, a, b, c, n);
+   for (t = 0; t < TRIALS; t++) {
+      do {
+         start = Now();
+         for (r = 0; r < reps; r++)
+            Run_kernel(k, a, b, c, n);
+         elapsed = Now() - start;
+         if (elapsed < MIN_TIME) reps *= 2;
+      } while (elapsed < MIN_TIME/2);
+      if (elapsed/reps < best) best = elapsed/reps;
+   }
+   return best;
+}  /* Time_kernel */
+
+/*---------------------------------------------------------------------
+ * Function:  Triad_bandwidth
+ * Purpose:   Measure the bandwidth of the triad with three arrays
+ *            taking bytes in all
+ * In arg:    bytes
+ * Ret val:   Bandwidth in GB/s (24 bytes per element)
+ */
+double Triad_bandwidth(long bytes) {
+   int n = bytes/(3*sizeof(double)), i;
+   double *a, *b, *c, elapsed;
+
+   a = malloc(n*sizeof(double));
+   b = malloc(n*sizeof(double));
+   c = malloc(n*sizeof(double));
+   if (a == NULL || b == NULL || c == NULL) {
+      fprintf(stderr, "Can't allocate triad arrays of %ld bytes\n", bytes);
+      exit(-1);
+   }
+   for (i = 0; i < n; i++) {
+      a[i] = 0.0;
+      b[i] = 1.0;
+      c[i] = 2.0;
+   }
+   elapsed = Time_kernel(-1, a, b, c, n);
+   free(a);
+   free(b);
+   free(c);
+
+   return 24.0*n/elapsed/1.0e9;
+}  /* Triad_bandwidth */
+
+/*---------------------------------------------------------------------
+ * Function:  Fma_peak
+ * Purpose:   Measure the peak floating point rate of the core
+ * Ret val:   GFLOP/s
+ * Note:      FMA_CHAINS independent multiply-adds per iteration keep
+ *            the vector units busy despite the latency of each one.
+ *            The accumulators converge to 1, so no overflow or
+ *            subnormals slow the loop down.
+ */
+double Fma_peak(void) {
+   double acc[FMA_CHAINS], start, elapsed, best = 1.0e30, sum = 0.0;
+   const double m = 0.999999, c = 1.0e-6;
+   int t, it, j;
+
+   for (t = 0; t < TRIALS; t++) {
+      for (j = 0; j < FMA_CHAINS; j++)
+         acc[j] = 1.0 + j;
+      start = Now();
+      for (it = 0; it < FMA_ITERS; it++)
+         for (j = 0; j < FMA_CHAINS; j++)
+            acc[j] = acc[j]*m + c;
+      elapsed = Now() - start;
+      if (elapsed < best) best = elapsed;
+      for (j = 0; j < FMA_CHAINS; j++)
+         sum += acc[j];
+   }
+   sink = sum;
+
+   return 2.0*FMA_CHAINS*FMA_ITERS/best/1.0e9;
+}  /* Fma_peak */
+
+/*---------------------------------------------------------------------
+ * Function:  Level_of
+ * Purpose:   Find the level of the memory hierarchy a working set of
+ *            bytes bytes fits in
+ * In args:   bytes, l2, l3
+ */
+level_t Level_of(long bytes, long l2, long l3) {
+   if (bytes <= l2) return LEVEL_L2;
+   if (bytes <= l3) return LEVEL_L3;
+   return LEVEL_DRAM;
+}  /* Level_of */
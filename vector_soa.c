@@ -0,0 +1,444 @@
+/* File:     vector_soa.c
+ *
+ * Purpose:  Store n points with 3 or 4 components each (positions,
+ *           velocities) in one of three layouts and add, scale and
+ *           take point-by-point dot products of them:
+ *
+ *           AoS:    the components of each point together,
+ *                   x0 y0 z0 x1 y1 z1 ...
+ *           SoA:    one array per component, x0 x1 ... y0 y1 ... z0 ...
+ *           AoSoA:  tiles of TILE points stored SoA, the tiles one
+ *                   after another, x0..x7 y0..y7 z0..z7 x8..x15 ...
+ *
+ *           The program checks that every layout gives the same
+ *           results, and prints the time of each kernel and of the
+ *           conversions to and from AoS.
+ *
+ * Compile:  gcc -O3 -Wall -o vector_soa vector_soa.c -lm
+ * Run:      ./vector_soa [-n <points>]
+ *
+ * Input:    None
+ * Output:   For 3 and 4 components and each layout:  us of add,
+ *           scale, dot, and of the conversion from and to AoS, with
+ *           the speedup of each kernel over AoS
+ *
+ * Notes:
+ * 1.  The default is n = 1000000 points.
+ * 2.  Scaling multiplies each component by its own factor (as in a
+ *     change of units), and the dot product gives one value per
+ *     point.  Both have a stride of 3 or 4 in AoS, which defeats SIMD;
+ *     in SoA and AoSoA every loop has unit stride.
+ * 3.  AoSoA pads n to a multiple of TILE.  The padding is zero.
+ * 4.  Times are the best of TRIALS runs.
+ * 5.  Sums and scaled vectors must be identical in every layout.  The
+ *     dot products are compared within DOT_TOL of the AoS ones, since
+ *     the compiler may contract or reorder the AoS products
+ *     differently (e.g. with -march=native).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#define TRIALS     5
+#define TILE       8
+#define MAX_COMPS  4
+#define DOT_TOL    1.0e-10
+
+typedef enum {LAYOUT_AOS, LAYOUT_SOA, LAYOUT_AOSOA} layout_t;
+
+typedef struct {
+   int       n;         /* number of points                       */
+   int       padded_n;  /* n rounded up to a multiple of TILE     */
+   int       comps;     /* components per point                   */
+   layout_t  layout;
+   double*   data;      /* comps*padded_n values                  */
+} mvector_t;
+
+static const char* layout_names[] = {"AoS", "SoA", "AoSoA"};
+
+void Usage(char prog_name[]);
+void Get_args(int argc, char* argv[], int* n_p);
+double Now(void);
+mvector_t* Mvector_alloc(int n, int comps, layout_t layout);
+void Mvector_free(mvector_t* v);
+void Mvector_from_aos(double aos[], mvector_t* v);
+void Mvector_to_aos(mvector_t* v, double aos[]);
+void Mvector_add(mvector_t* x, mvector_t* y, mvector_t* z);
+void Mvector_scale(mvector_t* x, double factors[]);
+void Mvector_dot(mvector_t* x, mvector_t* y, double dots[]);
+double Max_diff(double a[], double b[], int n);
+void Run_layouts(int n, int comps);
+
+/*---------------------------------------------------------------------*/
+int main(int argc, char* argv[]) {
+   int n;
+
+   Get_args(argc, argv, &n);
+
+   printf("n = %d points, times in us (speedup over AoS)\n", n);
+   printf("%5s %6s %17s %17s %17s %9s %9s\n", "comps", "layout", "add",
+         "scale", "dot", "from AoS", "to AoS");
+   Run_layouts(n, 3);
+   Run_layouts(n, 4);
+
+   return 0;
+}  /* main */
+
+/*---------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Print a message showing the command line options and
+ *            terminate
+ * In arg:    prog_name
+ */
+void Usage(char prog_name[]) {
+   fprintf(stderr, "usage: %s [-n <points>]\n", prog_name);
+   exit(0);
+}  /* Usage */
+
+/*---------------------------------------------------------------------
+ * Function:  Get_args
+ * Purpose:   Get the number of points from the command line
+ * In args:   argc, argv
+ * Out arg:   n_p
+ *
+ * Errors:    Unknown options and n <= 0 print the usage message
+ */
+void Get_args(
+      int    argc    /* in  */,
+      char*  argv[]  /* in  */,
+      int*   n_p     /* out */) {
+   int c;
+
+   *n_p = 1000000;
+   opterr = 0;
+   while ((c = getopt(argc, argv, "n:")) != -1)
+      switch (c) {
+         case 'n': *n_p = strtol(optarg, NULL, 10); break;
+         default:  Usage(argv[0]);
+      }
+   if (*n_p <= 0) Usage(argv[0]);
+}  /* Get_args */
+
+/*---------------------------------------------------------------------
+ * Function:  Now
+ * Purpose:   Return the time in seconds from a monotonic clock
+ */
+double Now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1.0e-9*ts.tv_nsec;
+}  /* Now */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_alloc
+ * Purpose:   Allocate a multi-component vector with zero components
+ * In args:   n:       number of points
+ *            comps:   components per point (1 to MAX_COMPS)
+ *            layout:  how the components are stored
+ * Ret val:   The vector, or NULL if it can't be allocated
+ */
+mvector_t* Mvector_alloc(int n, int comps, layout_t layout) {
+   mvector_t* v = malloc(sizeof(mvector_t));
+
+   if (v == NULL) return NULL;
+   v->n = n;
+   v->padded_n = layout == LAYOUT_AOSOA ? (n + TILE - 1)/TILE*TILE : n;
+   v->comps = comps;
+   v->layout = layout;
+   v->data = calloc((long) comps*v->padded_n, sizeof(double));
+   if (v->data == NULL) {
+      free(v);
+      return NULL;
+   }
+   return v;
+}  /* Mvector_alloc */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_free
+ * Purpose:   Free a vector allocated by Mvector_alloc
+ * In/out:    v
+ */
+void Mvector_free(mvector_t* v) {
+   if (v == NULL) return;
+   free(v->data);
+   free(v);
+}  /* Mvector_free */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_from_aos
+ * Purpose:   Copy n points stored AoS into v
+ * In arg:    aos:  v->comps*v->n values
+ * Out arg:   v
+ */
+void Mvector_from_aos(double aos[], mvector_t* v) {
+   int p, c, t, l, last, comps = v->comps, n = v->n;
+   double *d = v->data, *tile;
+
+   switch (v->layout) {
+      case LAYOUT_AOS:
+         memcpy(d, aos, (long) comps*n*sizeof(double));
+         break;
+      case LAYOUT_SOA:
+         for (p = 0; p < n; p++)
+            for (c = 0; c < comps; c++)
+               d[(long) c*n + p] = aos[(long) p*comps + c];
+         break;
+      case LAYOUT_AOSOA:
+         for (t = 0; t*TILE < n; t++) {
+            tile = d + (long) t*TILE*comps;
+            last = n - t*TILE < TILE ? n - t*TILE : TILE;
+            for (l = 0; l < last; l++)
+               for (c = 0; c < comps; c++)
+                  tile[c*TILE + l] = aos[((long) t*TILE + l)*comps + c];
+         }
+         break;
+   }
+}  /* Mvector_from_aos */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_to_aos
+ * Purpose:   Copy the points of v to an AoS array
+ * In arg:    v
+ * Out arg:   aos:  v->comps*v->n values
+ */
+void Mvector_to_aos(mvector_t* v, double aos[]) {
+   int p, c, t, l, last, comps = v->comps, n = v->n;
+   double *d = v->data, *tile;
+
+   switch (v->layout) {
+      case LAYOUT_AOS:
+         memcpy(aos, d, (long) comps*n*sizeof(double));
+         break;
+      case LAYOUT_SOA:
+         for (p = 0; p < n; p++)
+            for (c = 0; c < comps; c++)
+               aos[(long) p*comps + c] = d[(long) c*n + p];
+         break;
+      case LAYOUT_AOSOA:
+         for (t = 0; t*TILE < n; t++) {
+            tile = d + (long) t*TILE*comps;
+            last = n - t*TILE < TILE ? n - t*TILE : TILE;
+            for (l = 0; l < last; l++)
+               for (c = 0; c < comps; c++)
+                  aos[((long) t*TILE + l)*comps + c] = tile[c*TILE + l];
+         }
+         break;
+   }
+}  /* Mvector_to_aos */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_add
+ * Purpose:   z = x + y, point by point and component by component
+ * In args:   x, y:  vectors with the same n, comps and layout
+ * Out arg:   z:     a vector with the same n, comps and layout
+ * Note:      Element-wise addition doesn't depend on the layout, so
+ *            the data are added as a single array (the AoSoA padding
+ *            included).
+ */
+void Mvector_add(mvector_t* x, mvector_t* y, mvector_t* z) {
+   long i, total = (long) x->comps*x->padded_n;
+   double *xd = x->data, *yd = y->data, *zd = z->data;
+
+   for (i = 0; i < total; i++)
+      zd[i] = xd[i] + yd[i];
+}  /* Mvector_add */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_scale
+ * Purpose:   Multiply component c of every point by factors[c]
+ * In arg:    factors:  x->comps factors
+ * In/out:    x
+ */
+void Mvector_scale(mvector_t* x, double factors[]) {
+   int p, c, t, l, comps = x->comps, n = x->n;
+   double *d = x->data, *row, f;
+
+   switch (x->layout) {
+      case LAYOUT_AOS:
+         for (p = 0; p < n; p++)
+            for (c = 0; c < comps; c++)
+               d[(long) p*comps + c] *= factors[c];
+         break;
+      case LAYOUT_SOA:
+         for (c = 0; c < comps; c++) {
+            row = d + (long) c*n;
+            f = factors[c];
+            for (p = 0; p < n; p++)
+               row[p] *= f;
+         }
+         break;
+      case LAYOUT_AOSOA:
+         for (t = 0; t < x->padded_n/TILE; t++)
+            for (c = 0; c < comps; c++) {
+               row = d + ((long) t*comps + c)*TILE;
+               f = factors[c];
+               for (l = 0; l < TILE; l++)
+                  row[l] *= f;
+            }
+         break;
+   }
+}  /* Mvector_scale */
+
+/*---------------------------------------------------------------------
+ * Function:  Mvector_dot
+ * Purpose:   Find the dot product of each point of x with the same
+ *            point of y
+ * In args:   x, y:  vectors with the same n, comps and layout
+ * Out arg:   dots:  dots[p] = sum over c of x_p[c]*y_p[c].  For AoSoA
+ *                   it must have room for x->padded_n values.
+ * Note:      The components are added in the same order in every
+ *            layout, but the compiler may contract the products into
+ *            fused multiply-adds differently in each one, so the
+ *            results can differ in the last bits (see note 5).
+ */
+void Mvector_dot(mvector_t* x, mvector_t* y, double dots[]) {
+   int p, c, t, l, comps = x->comps, n = x->n;
+   double *xd = x->data, *yd = y->data, *xr, *yr, dot;
+
+   switch (x->layout) {
+      case LAYOUT_AOS:
+         for (p = 0; p < n; p++) {
+            dot = 0.0;
+            for (c = 0; c < comps; c++)
+               dot += xd[(long) p*comps + c]*yd[(long) p*comps + c];
+            dots[p] = dot;
+         }
+         break;
+      case LAYOUT_SOA:
+         for (p = 0; p < n; p++)
+            dots[p] = 0.0;
+         for (c = 0; c < comps; c++) {
+            xr = xd + (long) c*n;
+            yr = yd + (long) c*n;
+            for (p = 0; p < n; p++)
+               dots[p] += xr[p]*yr[p];
+         }
+         break;
+      case LAYOUT_AOSOA:
+         for (t = 0; t < x->padded_n/TILE; t++) {
+            double tile_dots[TILE] = {0.0};
+
+            for (c = 0; c < comps; c++) {
+               xr = xd + ((long) t*comps + c)*TILE;
+               yr = yd + ((long) t*comps + c)*TILE;
+               for (l = 0; l < TILE; l++)
+                  tile_dots[l] += xr[l]*yr[l];
+            }
+            memcpy(dots + (long) t*TILE, tile_dots, TILE*sizeof(double));
+         }
+         break;
+   }
+}  /* Mvector_dot */
+
+/*---------------------------------------------------------------------
+ * Function:  Max_diff
+ * Purpose:   Return the largest |a[i] - b[i]|
+ */
+double Max_diff(double a[], double b[], int n) {
+   int i;
+   double diff = 0.0;
+
+   for (i = 0; i < n; i++)
+      if (fabs(a[i] - b[i]) > diff) diff = fabs(a[i] - b[i]);
+   return diff;
+}  /* Max_diff */
+
+/*---------------------------------------------------------------------
+ * Function:  Run_layouts
+ * Purpose:   Check and time the kernels of every layout for n points
+ *            with comps components
+ * In args:   n, comps
+ */
+void Run_layouts(int n, int comps) {
+   double factors[MAX_COMPS] = {0.5, 2.0, 0.25, 4.0};
+   double *x_aos, *y_aos, *sum_ref, *dot_ref, *out, *dots;
+   double best[5], aos_best[3], start, elapsed;
+   mvector_t *x, *y, *z;
+   long i, total = (long) comps*n;
+   int layout, k, t;
+
+   x_aos = malloc(total*sizeof(double));
+   y_aos = malloc(total*sizeof(double));
+   sum_ref = malloc(total*sizeof(double));
+   out = malloc(total*sizeof(double));
+   dot_ref = malloc((n + TILE)*sizeof(double));
+   dots = malloc((n + TILE)*sizeof(double));
+   if (x_aos == NULL || y_aos == NULL || sum_ref == NULL || out == NULL
+         || dot_ref == NULL || dots == NULL) {
+      fprintf(stderr, "Can't allocate %d points\n", n);
+      exit(-1);
+   }
+   for (i = 0; i < total; i++) {
+      x_aos[i] = (rand() % 2001)/100.0 - 10.0;
+      y_aos[i] = (rand() % 2001)/100.0 - 10.0;
+   }
+
+   for (layout = LAYOUT_AOS; layout <= LAYOUT_AOSOA; layout++) {
+      x = Mvector_alloc(n, comps, layout);
+      y = Mvector_alloc(n, comps, layout);
+      z = Mvector_alloc(n, comps, layout);
+      if (x == NULL || y == NULL || z == NULL) {
+         fprintf(stderr, "Can't allocate %d points\n", n);
+         exit(-1);
+      }
+      for (k = 0; k < 5; k++)
+         best[k] = 1.0e30;
+
+      for (t = 0; t < TRIALS; t++) {
+         start = Now();
+         Mvector_from_aos(x_aos, x);
+         elapsed = Now() - start;
+         if (elapsed < best[3]) best[3] = elapsed;
+         Mvector_from_aos(y_aos, y);
+
+         start = Now();
+         Mvector_add(x, y, z);
+         elapsed = Now() - start;
+         if (elapsed < best[0]) best[0] = elapsed;
+
+         start = Now();
+         Mvector_dot(x, y, dots);
+         elapsed = Now() - start;
+         if (elapsed < best[2]) best[2] = elapsed;
+
+         start = Now();
+         Mvector_scale(z, factors);
+         elapsed = Now() - start;
+         if (elapsed < best[1]) best[1] = elapsed;
+
+         start = Now();
+         Mvector_to_aos(z, out);
+         elapsed = Now() - start;
+         if (elapsed < best[4]) best[4] = elapsed;
+      }
+
+      /* Mvector_add rewrites z every trial, so z = x + y scaled once */
+      if (layout == LAYOUT_AOS) {
+         memcpy(sum_ref, out, total*sizeof(double));
+         memcpy(dot_ref, dots, n*sizeof(double));
+         for (k = 0; k < 3; k++)
+            aos_best[k] = best[k];
+      } else if (memcmp(out, sum_ref, total*sizeof(double)) != 0
+            || Max_diff(dots, dot_ref, n) > DOT_TOL) {
+         fprintf(stderr, "%s results differ from AoS for %d components\n",
+               layout_names[layout], comps);
+         exit(-1);
+      }
+
+      printf("%5d %6s", comps, layout_names[layout]);
+      for (k = 0; k < 3; k++)
+         printf(" %9.1f (%4.2fx)", best[k]*1.0e6, aos_best[k]/best[k]);
+      printf(" %9.1f %9.1f\n", best[3]*1.0e6, best[4]*1.0e6);
+
+      Mvector_free(x);
+      Mvector_free(y);
+      Mvector_free(z);
+   }
+
+   free(x_aos); free(y_aos); free(sum_ref);
+   free(out); free(dot_ref); free(dots);
+}  /* Run_layouts */